@@ -0,0 +1,608 @@
+#include <obj/objparser.h>
+#include <obj/mtlparser.h>
+#include "../src/scanner.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/time.h>
+	#include <sys/resource.h>
+#endif
+
+/************************************************************************/
+/* Time and memory                                                      */
+/************************************************************************/
+
+// Wall clock time in seconds
+static double now()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+#endif
+}
+
+// Peak resident set size of the process so far, in megabytes
+static double peakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+		return 0.0;
+	return counters.PeakWorkingSetSize / ( 1024.0 * 1024.0 );
+#else
+	rusage usage;
+	if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+		return 0.0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / ( 1024.0 * 1024.0 );
+#else
+	return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+/************************************************************************/
+/* Synthetic input                                                      */
+/************************************************************************/
+
+// Deterministic random numbers, generated files are identical between runs
+class lcg
+{
+public:
+	lcg()
+		: _state( 12345 )
+	{
+		// empty
+	}
+
+	unsigned int next()
+	{
+		_state = _state * 1664525u + 1013904223u;
+		return _state >> 8;
+	}
+
+	double uniform( double min, double max )
+	{
+		return min + ( max - min ) * ( next() / 16777216.0 );
+	}
+
+private:
+	unsigned int _state;
+};
+
+// Writes lines to a file and counts them
+class generator
+{
+public:
+	generator( const std::string& filename, double sizeMB )
+		: numLines( 0 ), _limit( (long)( sizeMB * 1024 * 1024 ) )
+	{
+		_file = fopen( filename.c_str(), "wb" );
+	}
+
+	~generator()
+	{
+		if( _file )
+			fclose( _file );
+	}
+
+	bool isOpen() const
+	{
+		return _file != 0;
+	}
+
+	bool isFull() const
+	{
+		return ftell( _file ) >= _limit;
+	}
+
+	void line( const char* format, ... )
+	{
+		va_list args;
+		va_start( args, format );
+		vfprintf( _file, format, args );
+		va_end( args );
+
+		fputc( '\n', _file );
+		++numLines;
+	}
+
+	void vertex( const char* keyword )
+	{
+		line( "%s %.6f %.6f %.6f", keyword, random.uniform( -100, 100 ), random.uniform( -100, 100 ), random.uniform( -100, 100 ) );
+	}
+
+	unsigned long long numLines;
+	lcg random;
+
+private:
+	FILE* _file;
+	long _limit;
+};
+
+// Vertex only point cloud
+static void generatePoints( generator& out )
+{
+	while( !out.isFull() )
+		out.vertex( "v" );
+}
+
+// Point cloud with a color per vertex
+static void generateColoredPoints( generator& out )
+{
+	while( !out.isFull() )
+	{
+		out.line( "v %.6f %.6f %.6f %.4f %.4f %.4f", out.random.uniform( -100, 100 ), out.random.uniform( -100, 100 ), out.random.uniform( -100, 100 ),
+				  out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+	}
+}
+
+// Unshared triangles with texcoords and normals, indexed from the start or the end
+static void generateTriangles( generator& out, bool negative )
+{
+	int numVertices = 0;
+
+	while( !out.isFull() )
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			out.vertex( "v" );
+			out.line( "vt %.6f %.6f", out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+			out.vertex( "vn" );
+		}
+
+		if( negative )
+		{
+			out.line( "f -3/-3/-3 -2/-2/-2 -1/-1/-1" );
+		}
+		else
+		{
+			out.line( "f %d/%d/%d %d/%d/%d %d/%d/%d", numVertices + 1, numVertices + 1, numVertices + 1,
+					  numVertices + 2, numVertices + 2, numVertices + 2, numVertices + 3, numVertices + 3, numVertices + 3 );
+		}
+
+		numVertices += 3;
+	}
+}
+
+// Polygons of 64 vertices
+static void generatePolygons( generator& out )
+{
+	const int size = 64;
+	int numVertices = 0;
+	std::string face;
+	char index[16];
+
+	while( !out.isFull() )
+	{
+		face = "f";
+		for( int i = 0; i < size; ++i )
+		{
+			out.vertex( "v" );
+
+			sprintf( index, " %d", ++numVertices );
+			face += index;
+		}
+
+		out.line( "%s", face.c_str() );
+	}
+}
+
+// Group and material switch every two triangles
+static void generateGroups( generator& out )
+{
+	int numVertices = 0;
+	int numGroups = 0;
+
+	out.line( "mtllib synthetic.mtl" );
+
+	while( !out.isFull() )
+	{
+		out.line( "g group%d", numGroups );
+		out.line( "usemtl material%d", numGroups % 100 );
+		++numGroups;
+
+		for( int t = 0; t < 2; ++t )
+		{
+			for( int i = 0; i < 3; ++i )
+				out.vertex( "v" );
+
+			out.line( "f %d %d %d", numVertices + 1, numVertices + 2, numVertices + 3 );
+			numVertices += 3;
+		}
+	}
+}
+
+// Blocks of long comments between a few vertices
+static void generateComments( generator& out )
+{
+	while( !out.isFull() )
+	{
+		for( int i = 0; i < 100; ++i )
+			out.line( "# Exported by a synthetic generator, comment line %d of a long header block.", i );
+
+		for( int i = 0; i < 10; ++i )
+			out.vertex( "v" );
+	}
+}
+
+// Materials with colors, scalars and texture maps
+static void generateMaterials( generator& out )
+{
+	int numMaterials = 0;
+
+	while( !out.isFull() )
+	{
+		out.line( "newmtl material%d", numMaterials );
+		out.line( "Ka %.6f %.6f %.6f", out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+		out.line( "Kd %.6f %.6f %.6f", out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+		out.line( "Ks %.6f %.6f %.6f", out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+		out.line( "Ns %.3f", out.random.uniform( 0, 1000 ) );
+		out.line( "d %.3f", out.random.uniform( 0, 1 ) );
+		out.line( "Ni %.3f", out.random.uniform( 1, 2 ) );
+		out.line( "Ke %.6f %.6f %.6f", out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ), out.random.uniform( 0, 1 ) );
+		out.line( "illum 2" );
+		out.line( "map_Kd textures/diffuse%d.png", numMaterials );
+		out.line( "map_Ks -clamp on textures/specular%d.png", numMaterials );
+		out.line( "map_Bump -bm 0.5 -s 2 2 textures/bump%d.png", numMaterials );
+		out.line( "" );
+		++numMaterials;
+	}
+}
+
+/************************************************************************/
+/* Null sinks                                                           */
+/************************************************************************/
+
+// Receives every signal and only counts, so dispatch cost is measured
+template<typename Parser>
+class nullsink : public sig::has_slots<>
+{
+public:
+	typedef typename Parser::vector_type vector_type;
+
+	nullsink()
+		: numElements( 0 )
+	{
+		// empty
+	}
+
+	void connect( Parser& parser )
+	{
+		parser.errorSignal.connect( this, &nullsink::message_slot );
+		parser.commentSignal.connect( this, &nullsink::message_slot );
+		parser.vertexSignal.connect( this, &nullsink::vector_slot );
+		parser.normalSignal.connect( this, &nullsink::vector_slot );
+		parser.texcoordSignal.connect( this, &nullsink::vector_slot );
+		parser.faceBeginSignal.connect( this, &nullsink::faceBegin_slot );
+		parser.faceElementSignal.connect( this, &nullsink::faceElement_slot );
+		parser.faceEndSignal.connect( this, &nullsink::faceEnd_slot );
+		parser.objectNameSignal.connect( this, &nullsink::name_slot );
+		parser.groupNameSignal.connect( this, &nullsink::name_slot );
+		parser.materialLibSignal.connect( this, &nullsink::name_slot );
+		parser.materialUseSignal.connect( this, &nullsink::name_slot );
+	}
+
+	void message_slot( unsigned int /*lineNumber*/, const std::string& /*msg*/ ) { ++numElements; }
+	void vector_slot( const vector_type& /*v*/ ) { ++numElements; }
+	void faceBegin_slot( unsigned int /*numElements*/ ) { ++numElements; }
+	void faceElement_slot( const obj::face_index& /*idx*/ ) { ++numElements; }
+	void faceEnd_slot() { ++numElements; }
+	void name_slot( const std::string& /*name*/ ) { ++numElements; }
+
+	unsigned long long numElements;
+};
+
+template<typename Real>
+class nullbatchsink : public obj::basic_batchsink<Real>
+{
+	// empty, default implementations ignore all blocks
+};
+
+class nullmtlsink : public sig::has_slots<>
+{
+public:
+	void connect( obj::mtlparser& parser )
+	{
+		parser.errorSignal.connect( this, &nullmtlsink::message_slot );
+		parser.commentSignal.connect( this, &nullmtlsink::message_slot );
+		parser.beginMaterialSignal.connect( this, &nullmtlsink::name_slot );
+		parser.ambientSignal.connect( this, &nullmtlsink::color_slot );
+		parser.diffuseSignal.connect( this, &nullmtlsink::color_slot );
+		parser.specularSignal.connect( this, &nullmtlsink::color_slot );
+		parser.specularExpSignal.connect( this, &nullmtlsink::scalar_slot );
+		parser.opacitySignal.connect( this, &nullmtlsink::scalar_slot );
+		parser.refractionIndexSignal.connect( this, &nullmtlsink::scalar_slot );
+		parser.textureAmbientSignal.connect( this, &nullmtlsink::name_slot );
+		parser.textureDiffuseSignal.connect( this, &nullmtlsink::name_slot );
+		parser.textureSpecularSignal.connect( this, &nullmtlsink::name_slot );
+	}
+
+	void message_slot( unsigned int /*lineNumber*/, const std::string& /*msg*/ ) {}
+	void color_slot( const obj::vec3d& /*c*/ ) {}
+	void scalar_slot( double /*value*/ ) {}
+	void name_slot( const std::string& /*name*/ ) {}
+};
+
+/************************************************************************/
+/* Measurements                                                         */
+/************************************************************************/
+
+struct settings
+{
+	double sizeMB;
+	std::string directory;
+	unsigned int repeat;
+	unsigned int numThreads;
+	bool keepFiles;
+};
+
+enum parsemode
+{
+	FILE_MODE,		// parse( filename ), mapped when possible
+	STREAM_MODE,	// parse( std::istream& )
+	BATCH_MODE,		// parse( filename ) into a batch sink, or a material table for MTL files
+	FLOAT_MODE,		// objparserf, parse( filename )
+	SCAN_MODE		// line splitting alone, over contents already in memory
+};
+
+static const char* modeName( parsemode mode )
+{
+	switch( mode )
+	{
+	case FILE_MODE: return "file";
+	case STREAM_MODE: return "stream";
+	case BATCH_MODE: return "batch";
+	case FLOAT_MODE: return "float";
+	case SCAN_MODE: return "scan";
+	}
+	return "";
+}
+
+template<typename Parser>
+static void parseObj( const settings& config, const std::string& filename, parsemode mode )
+{
+	Parser parser;
+	parser.numThreads = config.numThreads;
+
+	nullsink<Parser> sink;
+	sink.connect( parser );
+
+	nullbatchsink<typename Parser::real_type> batch;
+	if( mode == BATCH_MODE )
+		parser.batchSink = &batch;
+
+	if( mode == STREAM_MODE )
+	{
+		std::ifstream file( filename.c_str(), std::ios::binary );
+		parser.parse( file );
+	}
+	else
+	{
+		parser.parse( filename.c_str() );
+	}
+}
+
+static void parseMtl( const settings& /*config*/, const std::string& filename, parsemode mode )
+{
+	obj::mtlparser parser;
+
+	nullmtlsink sink;
+	sink.connect( parser );
+
+	obj::materialtable table;
+	if( mode == BATCH_MODE )
+		parser.table = &table;
+
+	if( mode == STREAM_MODE )
+	{
+		std::ifstream file( filename.c_str(), std::ios::binary );
+		parser.parse( file );
+	}
+	else
+	{
+		parser.parse( filename.c_str() );
+	}
+}
+
+// Line splitting stage of the parsers, contents are read before timing
+class linescan
+{
+public:
+	linescan( const std::string& filename )
+		: numLines( 0 )
+	{
+		std::ifstream file( filename.c_str(), std::ios::binary );
+		_data.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+	}
+
+	void operator()( const settings& /*config*/, const std::string& /*filename*/, parsemode /*mode*/ )
+	{
+		const char* begin = _data.empty() ? 0 : &_data[0];
+		obj::scanner::linesplitter lines( begin, begin + _data.size() );
+		const char* line;
+		const char* lineEnd;
+
+		numLines = 0;
+		while( lines.next( line, lineEnd ) )
+			++numLines;
+	}
+
+	unsigned long long numLines;
+
+private:
+	std::vector<char> _data;
+};
+
+static void report( const char* name, parsemode mode, double sizeMB, unsigned long long numLines, double seconds )
+{
+	char row[256];
+	sprintf( row, "%-10s %-7s %9.1f %12.0f %9.3f %10.1f %10.2f %10.1f",
+			 name, modeName( mode ), sizeMB, (double)numLines, seconds,
+			 sizeMB / seconds, numLines / seconds / 1e6, peakMemory() );
+	std::cout << row << std::endl;
+}
+
+// Best time of repeated parses
+template<typename Function>
+static double measure( const settings& config, Function parse, const std::string& filename, parsemode mode )
+{
+	double best = 0.0;
+
+	for( unsigned int i = 0; i < config.repeat; ++i )
+	{
+		const double start = now();
+		parse( config, filename, mode );
+		const double seconds = now() - start;
+
+		if( i == 0 || seconds < best )
+			best = seconds;
+	}
+
+	return best;
+}
+
+static bool runCase( const settings& config, const std::string& name )
+{
+	const bool isMtl = ( name == "mtl" );
+	const std::string filename = config.directory + "/synthetic_" + name + ( isMtl ? ".mtl" : ".obj" );
+
+	unsigned long long numLines;
+	{
+		generator out( filename, config.sizeMB );
+		if( !out.isOpen() )
+		{
+			std::cout << "Cannot create file '" << filename << "'." << std::endl;
+			return false;
+		}
+
+		if( name == "points" )
+			generatePoints( out );
+		else if( name == "colors" )
+			generateColoredPoints( out );
+		else if( name == "triangles" )
+			generateTriangles( out, false );
+		else if( name == "negative" )
+			generateTriangles( out, true );
+		else if( name == "polygons" )
+			generatePolygons( out );
+		else if( name == "groups" )
+			generateGroups( out );
+		else if( name == "comments" )
+			generateComments( out );
+		else if( name == "mtl" )
+			generateMaterials( out );
+		else
+		{
+			std::cout << "Unknown case '" << name << "'." << std::endl;
+			return false;
+		}
+
+		numLines = out.numLines;
+	}
+
+	std::ifstream file( filename.c_str(), std::ios::binary | std::ios::ate );
+	const double sizeMB = (double)file.tellg() / ( 1024.0 * 1024.0 );
+	file.close();
+
+	if( isMtl )
+	{
+		const parsemode modes[] = { FILE_MODE, STREAM_MODE, BATCH_MODE };
+		for( size_t i = 0; i < sizeof( modes ) / sizeof( modes[0] ); ++i )
+			report( name.c_str(), modes[i], sizeMB, numLines, measure( config, parseMtl, filename, modes[i] ) );
+	}
+	else
+	{
+		const parsemode modes[] = { FILE_MODE, STREAM_MODE, BATCH_MODE };
+		for( size_t i = 0; i < sizeof( modes ) / sizeof( modes[0] ); ++i )
+			report( name.c_str(), modes[i], sizeMB, numLines, measure( config, parseObj<obj::objparser>, filename, modes[i] ) );
+
+		report( name.c_str(), FLOAT_MODE, sizeMB, numLines, measure( config, parseObj<obj::objparserf>, filename, FLOAT_MODE ) );
+	}
+
+	// Last, its copy of the contents raises peak memory
+	report( name.c_str(), SCAN_MODE, sizeMB, numLines, measure( config, linescan( filename ), filename, SCAN_MODE ) );
+
+	if( !config.keepFiles )
+		remove( filename.c_str() );
+
+	return true;
+}
+
+int main( int argc, char** argv )
+{
+	settings config;
+	config.sizeMB = 64.0;
+	config.directory = ".";
+	config.repeat = 3;
+	config.numThreads = 1;
+	config.keepFiles = false;
+
+	std::vector<std::string> cases;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const std::string arg = argv[i];
+
+		if( arg == "-size" && i + 1 < argc )
+			config.sizeMB = atof( argv[++i] );
+		else if( arg == "-dir" && i + 1 < argc )
+			config.directory = argv[++i];
+		else if( arg == "-repeat" && i + 1 < argc )
+			config.repeat = (unsigned int)atoi( argv[++i] );
+		else if( arg == "-threads" && i + 1 < argc )
+			config.numThreads = (unsigned int)atoi( argv[++i] );
+		else if( arg == "-keep" )
+			config.keepFiles = true;
+		else if( arg[0] == '-' )
+		{
+			std::cout << "Usage: benchmark [-size MB] [-dir directory] [-repeat n] [-threads n] [-keep] [case ...]" << std::endl;
+			std::cout << "Cases: points colors triangles negative polygons groups comments mtl" << std::endl;
+			return 1;
+		}
+		else
+			cases.push_back( arg );
+	}
+
+	if( config.repeat == 0 )
+		config.repeat = 1;
+
+	if( cases.empty() )
+	{
+		const char* all[] = { "points", "colors", "triangles", "negative", "polygons", "groups", "comments", "mtl" };
+		cases.assign( all, all + sizeof( all ) / sizeof( all[0] ) );
+	}
+
+	std::cout << "line scanning: " << obj::scanner::instructionSet() << std::endl;
+
+	// Peak memory is the process high-water mark, run a single case for isolated figures
+	std::cout << "case       mode           MB        lines   seconds       MB/s    Mlines/s    peak MB" << std::endl;
+
+	for( size_t i = 0; i < cases.size(); ++i )
+	{
+		if( !runCase( config, cases[i] ) )
+			return 1;
+	}
+
+	return 0;
+}
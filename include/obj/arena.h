@@ -0,0 +1,193 @@
+#ifndef _OBJ_ARENA_H_
+#define _OBJ_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Monotonic allocator: memory is handed out from large blocks and only
+	 *	given back all at once, by rewinding to a mark or resetting.
+	 *
+	 *	Blocks are kept when rewinding, so a thread reusing one arena for
+	 *	many parses stops calling the heap once the largest parse fit.
+	 *	Not thread safe, use one arena per thread.
+	 */
+	class arena
+	{
+	public:
+		enum
+		{
+			DEFAULT_BLOCK_SIZE = 1 << 20,
+			ALIGNMENT = 8		// enough for any number type parsed
+		};
+
+		// Allocation state to rewind to
+		struct position
+		{
+			size_t block;
+			size_t used;
+		};
+
+		explicit arena( size_t blockSize = DEFAULT_BLOCK_SIZE );
+		~arena();
+
+		// Aligned to ALIGNMENT, never fails but may throw std::bad_alloc
+		void* allocate( size_t size )
+		{
+			size = ( size + ALIGNMENT - 1 ) & ~(size_t)( ALIGNMENT - 1 );
+
+			if( size > _blockEnd - _used )
+				return allocateBlock( size );
+
+			void* p = _blocks[_current].data + _used;
+			_used += size;
+			return p;
+		}
+
+		position mark() const;
+
+		// Free everything allocated after mark was taken
+		void rewind( const position& mark );
+
+		// Free everything, keeps blocks for reuse
+		void reset();
+
+		// Free everything and give blocks back to the heap
+		void release();
+
+		// Bytes in blocks owned by arena
+		size_t capacity() const;
+
+	private:
+		// Non copyable
+		arena( const arena& );
+		arena& operator=( const arena& );
+
+		struct block
+		{
+			char* data;
+			size_t size;
+		};
+
+		// Continue in next block large enough, allocating it if needed
+		void* allocateBlock( size_t size );
+
+		std::vector<block> _blocks;
+		size_t _blockSize;
+
+		// Allocating from _blocks[_current], [_used, _blockEnd) is free
+		size_t _current;
+		size_t _used;
+		size_t _blockEnd;
+	};
+
+	// Rewinds arena on destruction to where it was on construction, does nothing without an arena
+	class arenascope
+	{
+	public:
+		arenascope( arena* memory )
+			: _memory( memory )
+		{
+			if( _memory )
+				_mark = _memory->mark();
+		}
+
+		~arenascope()
+		{
+			if( _memory )
+				_memory->rewind( _mark );
+		}
+
+	private:
+		// Non copyable
+		arenascope( const arenascope& );
+		arenascope& operator=( const arenascope& );
+
+		arena* _memory;
+		arena::position _mark;
+	};
+
+	/*
+	 *	Standard allocator taking memory from an arena, for containers of
+	 *	per-parse data. Deallocation is a no-op: memory comes back when the
+	 *	arena is rewound. Without an arena it uses the heap.
+	 */
+	template<typename T>
+	class arenaallocator
+	{
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		template<typename U>
+		struct rebind
+		{
+			typedef arenaallocator<U> other;
+		};
+
+		arenaallocator( arena* memory = 0 )
+			: _memory( memory )
+		{
+			// empty
+		}
+
+		template<typename U>
+		arenaallocator( const arenaallocator<U>& other )
+			: _memory( other.memory() )
+		{
+			// empty
+		}
+
+		arena* memory() const { return _memory; }
+
+		pointer allocate( size_type n, const void* /*hint*/ = 0 )
+		{
+			if( n > max_size() )
+				throw std::bad_alloc();
+
+			if( _memory )
+				return (pointer)_memory->allocate( n * sizeof( T ) );
+
+			return (pointer)::operator new( n * sizeof( T ) );
+		}
+
+		void deallocate( pointer p, size_type /*n*/ )
+		{
+			if( !_memory )
+				::operator delete( p );
+		}
+
+		void construct( pointer p, const T& value ) { new( p ) T( value ); }
+		void destroy( pointer p ) { p->~T(); }
+
+		pointer address( reference r ) const { return &r; }
+		const_pointer address( const_reference r ) const { return &r; }
+
+		size_type max_size() const { return (size_type)-1 / sizeof( T ); }
+
+	private:
+		arena* _memory;
+	};
+
+	template<typename T, typename U>
+	bool operator==( const arenaallocator<T>& a, const arenaallocator<U>& b )
+	{
+		return a.memory() == b.memory();
+	}
+
+	template<typename T, typename U>
+	bool operator!=( const arenaallocator<T>& a, const arenaallocator<U>& b )
+	{
+		return a.memory() != b.memory();
+	}
+}
+
+#endif // _OBJ_ARENA_H_
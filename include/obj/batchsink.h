@@ -0,0 +1,70 @@
+#ifndef _OBJ_BATCHSINK_H_
+#define _OBJ_BATCHSINK_H_
+
+#include <obj/types.h>
+#include <cstddef>
+
+namespace obj
+{
+	/*
+	 *	Receives parsed geometry in blocks instead of one signal per element.
+	 *
+	 *	Blocks are delivered in file order, each one holding a single kind
+	 *	of element. Arrays are only valid during the call.
+	 *
+	 *	Real is the precision of the parser delivering the blocks.
+	 */
+	template<typename Real>
+	class basic_batchsink
+	{
+	public:
+		virtual ~basic_batchsink()
+		{
+			// empty
+		}
+
+		virtual void vertices( const vec3<Real>* /*v*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		// Weights of all vertices of the vertices() block just sent, only after blocks of "v x y z w" lines
+		virtual void vertexWeights( const Real* /*w*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		// Colors of all vertices of the vertices() block just sent, only after blocks of "v x y z r g b" lines
+		virtual void vertexColors( const vec3<Real>* /*c*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		virtual void normals( const vec3<Real>* /*n*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		virtual void texcoords( const vec3<Real>* /*t*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		virtual void parameters( const vec3<Real>* /*p*/, size_t /*count*/ )
+		{
+			// empty
+		}
+
+		// Face i has sizes[i] consecutive elements, malformed elements are not counted
+		virtual void faces( const unsigned int* /*sizes*/, size_t /*numFaces*/,
+							const face_index* /*elements*/, size_t /*numElements*/ )
+		{
+			// empty
+		}
+	};
+
+	typedef basic_batchsink<double> batchsink;
+	typedef basic_batchsink<float> batchsinkf;
+}
+
+#endif // _OBJ_BATCHSINK_H_
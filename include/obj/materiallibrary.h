@@ -0,0 +1,190 @@
+#ifndef _OBJ_MATERIALLIBRARY_H_
+#define _OBJ_MATERIALLIBRARY_H_
+
+#include <obj/types.h>
+#include <obj/materialtable.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	class mutex;
+	class condition;
+
+	/*
+	 *	Material libraries shared by many OBJ loads.
+	 *
+	 *	Each library is parsed once per resolved path into a materialtable,
+	 *	so its materials, maps and names are one block. Material IDs are
+	 *	handed out in library order: the materials of a library are
+	 *	consecutive IDs in table order. Nothing is removed, so IDs and
+	 *	references stay valid for the lifetime of the library.
+	 *
+	 *	All methods may be called from concurrent loads: a library requested
+	 *	while another thread parses it waits for that parse. Only load() and
+	 *	numMaterials() lock, lookups with library indices and IDs obtained
+	 *	from them read tables that do not change anymore.
+	 */
+	class materiallibrary
+	{
+	public:
+		// Library not found or material not defined
+		enum
+		{
+			NOT_FOUND = 0xffffffff
+		};
+
+		materiallibrary();
+		~materiallibrary();
+
+		// Path of filename referenced by an OBJ file, relative to the OBJ's directory unless absolute
+		static std::string resolve( const std::string& objFilename, const std::string& filename );
+
+		// Parse library at resolved path unless already done, returns library index
+		unsigned int load( const std::string& path );
+
+		// Parse errors of a loaded library: <lineNumber, message>
+		typedef std::vector< std::pair<unsigned int, std::string> > errorlist;
+
+		// Whether a loaded library file could be opened
+		bool isFound( unsigned int library ) const;
+
+		const errorlist& errors( unsigned int library ) const;
+
+		// Materials, maps and names of a loaded library, material i has ID firstMaterial( library ) + i
+		const materialtable& table( unsigned int library ) const;
+		unsigned int firstMaterial( unsigned int library ) const;
+
+		// ID of material defined in library, NOT_FOUND if not defined there
+		unsigned int find( unsigned int library, const std::string& name ) const;
+		unsigned int find( unsigned int library, const char* name ) const;
+
+		// Material by ID, its maps and filenames are in the table of its library
+		const materialrecord& get( unsigned int id ) const;
+		const char* name( unsigned int id ) const;
+		unsigned int library( unsigned int id ) const;
+
+		unsigned int numMaterials() const;
+
+	private:
+		// Non copyable
+		materiallibrary( const materiallibrary& );
+		materiallibrary& operator=( const materiallibrary& );
+
+		/*
+		 *	Append only array whose elements never move. Appending needs the
+		 *	lock, elements published under it are read without.
+		 */
+		template<typename T>
+		class pagedarray
+		{
+		public:
+			pagedarray();
+			~pagedarray();
+
+			// Default constructed element at index size()
+			T& append();
+
+			T& operator[]( unsigned int i ) { return page( i )[offset( i )]; }
+			const T& operator[]( unsigned int i ) const { return page( i )[offset( i )]; }
+
+			unsigned int size() const { return _size; }
+
+		private:
+			// Non copyable
+			pagedarray( const pagedarray& );
+			pagedarray& operator=( const pagedarray& );
+
+			// Page k holds elements [FIRST_PAGE_SIZE * ( 2^k - 1 ), FIRST_PAGE_SIZE * ( 2^( k + 1 ) - 1 ))
+			enum
+			{
+				FIRST_PAGE_SIZE = 16,
+				NUM_PAGES = 28
+			};
+
+			static unsigned int pageIndex( unsigned int i );
+			T* page( unsigned int i ) const { return _pages[pageIndex( i )]; }
+			static unsigned int offset( unsigned int i ) { return i + FIRST_PAGE_SIZE - ( FIRST_PAGE_SIZE << pageIndex( i ) ); }
+
+			T* _pages[NUM_PAGES];
+			unsigned int _size;
+		};
+
+		class entry
+		{
+		public:
+			entry();
+
+			std::string path;
+			bool loaded;
+			bool found;
+			errorlist errors;
+
+			materialtable table;
+			unsigned int firstId;
+
+			// Material indices in table sorted by name, last definition of a name defined twice
+			std::vector<unsigned int> byName;
+		};
+
+		// Index of each resolved path
+		std::map<std::string, unsigned int> _paths;
+
+		pagedarray<entry> _libraries;
+
+		// Library of each material ID
+		pagedarray<unsigned int> _materialLibraries;
+
+		mutex* _guard;
+		condition* _loaded;
+	};
+
+	/*
+	 *	Resolves mtllib and usemtl of one OBJ parse against a shared
+	 *	materiallibrary. Connect it to the parser, then usemtl names are
+	 *	sent as material IDs, looked up in the libraries referenced so far
+	 *	in reference order.
+	 */
+	class materialbinder : public sig::has_slots<>
+	{
+	public:
+		// objFilename is used to resolve relative library paths, may be empty
+		materialbinder( materiallibrary& library, const std::string& objFilename );
+
+		// Any basic_objparser
+		template<typename Parser>
+		void connect( Parser& parser )
+		{
+			parser.materialLibSignal.connect( this, &materialbinder::materialLib_slot );
+			parser.materialUseSignal.connect( this, &materialbinder::materialUse_slot );
+		}
+
+		// ID of material in the libraries referenced so far, NOT_FOUND if undefined
+		unsigned int find( const std::string& name ) const;
+
+		// Current material ID, NOT_FOUND before the first usemtl or for unknown names
+		unsigned int current() const { return _current; }
+
+		/************************************************************************/
+		/* Notifications                                                        */
+		/************************************************************************/
+
+		// Material used by next primitives, materiallibrary::NOT_FOUND if undefined
+		sig::signal1<unsigned int> materialSignal;
+
+		// Errors of libraries referenced: <lineNumber in library, "path: message">
+		sig::signal2<unsigned int, const std::string&> errorSignal;
+
+		void materialLib_slot( const std::string& filenames );
+		void materialUse_slot( const std::string& name );
+
+	private:
+		materiallibrary& _library;
+		std::string _objFilename;
+		std::vector<unsigned int> _used;
+		unsigned int _current;
+	};
+}
+
+#endif // _OBJ_MATERIALLIBRARY_H_
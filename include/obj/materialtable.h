@@ -0,0 +1,223 @@
+#ifndef _OBJ_MATERIALTABLE_H_
+#define _OBJ_MATERIALTABLE_H_
+
+#include <obj/types.h>
+#include <cstddef>
+#include <vector>
+
+namespace obj
+{
+	class mtlparser;
+
+	/*
+	 *	Texture map statement of an MTL material with its options.
+	 *	Options not given in the file keep their defaults.
+	 */
+	class texturemap
+	{
+	public:
+		// Statement of the map
+		enum maptype
+		{
+			AMBIENT,			// map_Ka
+			DIFFUSE,			// map_Kd
+			SPECULAR,			// map_Ks
+			SPECULAR_EXPONENT,	// map_Ns
+			OPACITY,			// map_d
+			EMISSIVE,			// map_Ke
+			BUMP,				// bump, map_Bump
+			DISPLACEMENT,		// disp
+			DECAL,				// decal
+			REFLECTION,			// refl
+			ROUGHNESS,			// map_Pr
+			METALLIC,			// map_Pm
+			SHEEN,				// map_Ps
+			NORMAL,				// norm
+			NUM_TYPES
+		};
+
+		// -imfchan, channel of the image used by scalar maps
+		enum channel
+		{
+			CHANNEL_DEFAULT,
+			CHANNEL_R,
+			CHANNEL_G,
+			CHANNEL_B,
+			CHANNEL_M,
+			CHANNEL_L,
+			CHANNEL_Z
+		};
+
+		// -type of reflection maps
+		enum projection
+		{
+			PROJECTION_DEFAULT,
+			SPHERE,
+			CUBE_TOP,
+			CUBE_BOTTOM,
+			CUBE_FRONT,
+			CUBE_BACK,
+			CUBE_LEFT,
+			CUBE_RIGHT
+		};
+
+		// On/off options
+		enum
+		{
+			BLEND_U = 1 << 0,			// -blendu
+			BLEND_V = 1 << 1,			// -blendv
+			CLAMP = 1 << 2,				// -clamp
+			COLOR_CORRECTION = 1 << 3	// -cc
+		};
+
+		texturemap();
+
+		unsigned int filename;		// offset in materialtable::text(), rest of the line after the options
+		unsigned int type;			// maptype
+		unsigned int flags;			// default = BLEND_U | BLEND_V
+		unsigned int channel;		// default = CHANNEL_DEFAULT
+		unsigned int projection;	// default = PROJECTION_DEFAULT
+		int resolution;				// -texres, default = 0, not given
+		float bumpMultiplier;		// -bm, default = 1
+		float boost;				// -boost, default = 0
+		float base;					// -mm, default = 0
+		float gain;					// -mm, default = 1
+		vec3f origin;				// -o, default = 0 0 0
+		vec3f scale;				// -s, default = 1 1 1
+		vec3f turbulence;			// -t, default = 0 0 0
+	};
+
+	/*
+	 *	Material of an MTL file. Statements not given in the file keep
+	 *	their defaults and are left out of the given mask.
+	 */
+	class materialrecord
+	{
+	public:
+		// Statements given in the file
+		enum
+		{
+			AMBIENT = 1 << 0,				// Ka
+			DIFFUSE = 1 << 1,				// Kd
+			SPECULAR = 1 << 2,				// Ks
+			EMISSIVE = 1 << 3,				// Ke
+			TRANSMISSION = 1 << 4,			// Tf
+			SPECULAR_EXPONENT = 1 << 5,		// Ns
+			OPACITY = 1 << 6,				// d, or Tr stored as 1 - Tr
+			HALO = 1 << 7,					// d -halo
+			REFRACTION_INDEX = 1 << 8,		// Ni
+			SHARPNESS = 1 << 9,				// sharpness
+			ILLUMINATION = 1 << 10,			// illum
+			ROUGHNESS = 1 << 11,			// Pr
+			METALLIC = 1 << 12,				// Pm
+			SHEEN = 1 << 13,				// Ps
+			CLEARCOAT = 1 << 14,			// Pc
+			CLEARCOAT_ROUGHNESS = 1 << 15,	// Pcr
+			ANISOTROPY = 1 << 16,			// aniso
+			ANISOTROPY_ROTATION = 1 << 17	// anisor
+		};
+
+		materialrecord();
+
+		unsigned int name;			// offset in materialtable::text()
+		unsigned int given;			// default = 0
+		unsigned int illumination;	// default = 0
+
+		vec3f ambient;				// default = 0 0 0
+		vec3f diffuse;				// default = 0 0 0
+		vec3f specular;				// default = 0 0 0
+		vec3f emissive;				// default = 0 0 0
+		vec3f transmission;			// default = 1 1 1
+
+		float specularExp;			// default = 0
+		float opacity;				// default = 1, from d or 1 - Tr, whichever comes last
+		float refractionIndex;		// default = 1
+		float sharpness;			// default = 60
+
+		// Physically based extension
+		float roughness;			// default = 0
+		float metallic;				// default = 0
+		float sheen;				// default = 0
+		float clearcoat;			// default = 0
+		float clearcoatRoughness;	// default = 0
+		float anisotropy;			// default = 0
+		float anisotropyRotation;	// default = 0
+
+		// Maps of the material are materialtable::maps()[firstMap, firstMap + numMaps)
+		unsigned int firstMap;
+		unsigned int numMaps;
+	};
+
+	// Compile time layout checks, array size is negative if padding was added
+	typedef char texturemap_is_packed[sizeof( texturemap ) == 19 * 4 ? 1 : -1];
+	typedef char materialrecord_is_packed[sizeof( materialrecord ) == 31 * 4 ? 1 : -1];
+
+	/*
+	 *	All materials of an MTL file, filled in one pass by an mtlparser
+	 *	whose table points to it.
+	 *
+	 *	Records hold no pointers: names and filenames are offsets of null
+	 *	terminated text. Once parsed, materials, maps and text are packed
+	 *	in that order into a single block, which can be copied or uploaded
+	 *	as is. Material statements before the first newmtl are ignored.
+	 */
+	class materialtable
+	{
+	public:
+		// Material not defined
+		enum
+		{
+			NOT_FOUND = 0xffffffff
+		};
+
+		materialtable();
+
+		void clear();
+
+		const materialrecord* materials() const { return (const materialrecord*)data(); }
+		unsigned int numMaterials() const { return _numMaterials; }
+
+		const texturemap* maps() const { return (const texturemap*)( (const char*)data() + _mapsOffset ); }
+		unsigned int numMaps() const { return _numMaps; }
+
+		// Null terminated text at offset
+		const char* text( unsigned int offset ) const { return (const char*)data() + _textOffset + offset; }
+
+		// Index of material, the last definition of a name defined twice
+		unsigned int find( const char* name ) const;
+
+		// Block holding materials, maps and text
+		const void* data() const { return _block.empty() ? 0 : &_block[0]; }
+		size_t size() const { return _block.size() * sizeof( unsigned int ); }
+
+	private:
+		friend class mtlparser;
+
+		// Start a material, records are staged until pack
+		materialrecord& beginMaterial( const char* name, const char* nameEnd );
+
+		// Map of current material
+		texturemap& addMap( const texturemap& map, const char* filename, const char* filenameEnd );
+
+		// Current material, null before the first newmtl
+		materialrecord* current() { return _materials.empty() ? 0 : &_materials.back(); }
+
+		unsigned int addText( const char* begin, const char* end );
+
+		// Move staged records into the block
+		void pack();
+
+		std::vector<materialrecord> _materials;
+		std::vector<texturemap> _maps;
+		std::vector<char> _text;
+
+		// Every field is 4 bytes, so is the alignment of the block
+		std::vector<unsigned int> _block;
+		unsigned int _numMaterials;
+		unsigned int _numMaps;
+		size_t _mapsOffset;
+		size_t _textOffset;
+	};
+}
+
+#endif // _OBJ_MATERIALTABLE_H_
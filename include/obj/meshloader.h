@@ -0,0 +1,124 @@
+#ifndef _OBJ_MESHLOADER_H_
+#define _OBJ_MESHLOADER_H_
+
+#include <obj/types.h>
+#include <obj/arena.h>
+#include <vector>
+
+namespace obj
+{
+	class materiallibrary;
+
+	/*
+	 *	Indexed triangle mesh ready for upload to the GPU.
+	 *
+	 *	Every unique v/vt/vn triple referenced by a face becomes one
+	 *	vertex. Polygons are triangulated by the parser, concave ones
+	 *	by ear clipping.
+	 *
+	 *	When normals are generated, v/vt pairs without vn are also told
+	 *	apart by smoothing group, and faces with smoothing off get
+	 *	vertices of their own.
+	 */
+	class indexedmesh
+	{
+	public:
+		typedef std::vector< float, arenaallocator<float> > floatarray;
+		typedef std::vector< unsigned int, arenaallocator<unsigned int> > indexarray;
+
+		// Range of triangles using one material
+		class part
+		{
+		public:
+			std::string material;
+
+			// ID in meshloader::materials, materiallibrary::NOT_FOUND if undefined or no library set
+			unsigned int materialId;
+
+			unsigned int firstIndex;
+			unsigned int numIndices;
+		};
+
+		// Arrays are allocated from memory if set, which must outlive them
+		indexedmesh( arena* memory = 0 );
+
+		// Arena arrays are released so their arena can be reset afterwards
+		void clear();
+
+		unsigned int numVertices;
+
+		// Attributes present, texcoords and normals are left out when no face references them
+		bool hasTexCoords;
+		bool hasNormals;
+		bool hasTangents;
+
+		// Interleaved layout: position (3), texcoord (2), normal (3), tangent (4)
+		unsigned int vertexStride; // number of floats per vertex
+		floatarray vertices;
+
+		// Separate layout
+		floatarray positions;	// 3 per vertex
+		floatarray texcoords;	// 2 per vertex
+		floatarray normals;		// 3 per vertex
+		floatarray tangents;	// 4 per vertex: direction and handedness of bitangent
+
+		// 3 per triangle
+		indexarray indices;
+
+		std::vector<part> parts;
+	};
+
+	/*
+	 *	Loads OBJ files straight into an indexedmesh.
+	 *
+	 *	Faces referencing attributes out of range are reported with their
+	 *	line through errorSignal and skipped, as are points and lines.
+	 */
+	class meshloader
+	{
+	public:
+		meshloader();
+
+		void load( const char* filename, indexedmesh& mesh );
+		void load( std::istream& file, indexedmesh& mesh );
+
+		/************************************************************************/
+		/* Loading flags                                                        */
+		/************************************************************************/
+
+		// Fill vertices instead of positions, texcoords and normals
+		bool interleaved; // default = false
+
+		// Passed on to objparser
+		unsigned int numThreads; // default = 1
+
+		// Temporaries of each load are allocated here and given back when it returns, must not be the mesh's arena
+		arena* memory; // default = 0, heap
+
+		// Shared by loads to parse each material library once and identify materials by ID
+		materiallibrary* materials; // default = 0
+
+		// Compute normals of vertices without vn, summed over faces of the same smoothing group
+		// Faces before any s line are smooth, faces with s off are flat
+		bool generateNormals; // default = false
+
+		// Weight face normals by their angle at each vertex instead of their area
+		bool angleWeightedNormals; // default = false
+
+		// Compute tangents of meshes with texcoords and normals, see meshnormals
+		bool generateTangents; // default = false
+
+		// Reorder triangles for the vertex cache and vertices for fetch locality, see meshoptimizer
+		bool optimize; // default = false
+
+		/************************************************************************/
+		/* Loading notifications                                                */
+		/* <lineNumber, message>                                                */
+		/************************************************************************/
+
+		// Error signal, including objparser errors
+		sig::signal2<unsigned int, const std::string&> errorSignal;
+	};
+}
+
+#endif // _OBJ_MESHLOADER_H_
@@ -0,0 +1,42 @@
+#ifndef _OBJ_MESHNORMALS_H_
+#define _OBJ_MESHNORMALS_H_
+
+namespace obj
+{
+	class indexedmesh;
+
+	/*
+	 *	Vertex normals and tangents of an indexedmesh in separate layout.
+	 *
+	 *	Triangles are processed in fixed size blocks shared by the threads.
+	 *	Each block adds its triangles straight into the vertices first
+	 *	referenced by it, which are its own since indexedmesh numbers
+	 *	vertices in order of first use, and keeps the few others aside to
+	 *	be added once all blocks are done. Results do not depend on the
+	 *	number of threads.
+	 */
+	class meshnormals
+	{
+	public:
+		meshnormals();
+
+		// Vertices i with generated[i] set get the normalized sum of the normals of their triangles,
+		// every vertex if generated is null, other normals are kept as they are
+		void computeNormals( indexedmesh& mesh, const unsigned char* generated = 0 ) const;
+
+		// Tangent of every vertex in the direction of increasing u and orthogonal to its normal,
+		// w = 1 or -1 is the handedness of the bitangent, needs texcoords and normals
+		void computeTangents( indexedmesh& mesh ) const;
+
+		/************************************************************************/
+		/* Shading flags                                                        */
+		/************************************************************************/
+
+		// Weight triangle normals by their angle at the vertex instead of their area
+		bool angleWeighted; // default = false
+
+		unsigned int numThreads; // default = 1, 0 = one per processor
+	};
+}
+
+#endif // _OBJ_MESHNORMALS_H_
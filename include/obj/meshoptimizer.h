@@ -0,0 +1,35 @@
+#ifndef _OBJ_MESHOPTIMIZER_H_
+#define _OBJ_MESHOPTIMIZER_H_
+
+namespace obj
+{
+	class indexedmesh;
+
+	/*
+	 *	Reorders an indexedmesh for the GPU.
+	 *
+	 *	Triangles of each part are reordered for the post-transform vertex
+	 *	cache with Tipsify (Sander, Nehab and Barczak, "Fast Triangle
+	 *	Reordering for Vertex Locality and Reduced Overdraw", 2007), then
+	 *	vertices are renumbered in order of first use so they are fetched
+	 *	sequentially. Parts keep their ranges, vertices no triangle uses
+	 *	move to the end. Time is linear in the number of triangles.
+	 */
+	class meshoptimizer
+	{
+	public:
+		meshoptimizer();
+
+		// Either layout
+		void optimize( indexedmesh& mesh ) const;
+
+		/************************************************************************/
+		/* Optimization flags                                                   */
+		/************************************************************************/
+
+		// Number of vertices the target's post-transform cache is assumed to hold
+		unsigned int cacheSize; // default = 16
+	};
+}
+
+#endif // _OBJ_MESHOPTIMIZER_H_
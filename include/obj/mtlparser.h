@@ -2,6 +2,10 @@
 #define _OBJ_MTLPARSER_H_
 
 #include <obj/types.h>
+#include <obj/parsestats.h>
+#include <obj/materialtable.h>
+#include <cstddef>
+#include <string>
 
 namespace obj
 {
@@ -9,15 +13,36 @@ namespace obj
 	 *	MTL File format description:
 	 *	http://local.wasp.uwa.edu.au/~pbourke/dataformats/mtl/
 	 *	
+	 *	Also reads the physically based extension (Pr, Pm, Ps, Pc, Pcr,
+	 *	aniso, anisor, Ke, norm and their maps). Statements without a
+	 *	signal below are only kept when parsing into a table.
+	 *	
+	 *	Strings sent with signals are built in one buffer reused by every
+	 *	line. There is no arena: the only other allocations are those of
+	 *	the table, which outlives the parse.
+	 *	
 	 *	Known issues:
-	 *		. texture map options not supported
-	 *		. only reads first word from texture filename
+	 *		. spectral and CIEXYZ colors not supported
 	 */
 	class mtlparser
 	{
 	public:
+		mtlparser();
+
+		// gzip and zstd files are decompressed while parsing, see README for build options
 		void parse( const char* filename );
 		void parse( std::istream& file );
+		void parse( const char* data, size_t size );
+
+		/************************************************************************/
+		/* Parsing flags                                                        */
+		/************************************************************************/
+
+		// Collect counts and times of each parse
+		mtlstats* stats; // default = 0
+
+		// Fill table with all materials, replacing its contents, instead of sending material and texture signals
+		materialtable* table; // default = 0
 
 		/************************************************************************/
 		/* Parsing notifications                                                */
@@ -69,7 +94,58 @@ namespace obj
 		sig::signal1<const std::string&> textureSpecularSignal;
 
 	private:
-		bool parseTextureMap( unsigned int lineNumber, std::stringstream& ss, std::string& filename );
+		unsigned int _lineNumber;
+
+		// Start of current parse when collecting stats
+		double _startTime;
+
+		// Names, filenames and messages sent with signals, reused by every line
+		std::string _buffer;
+
+		void reset();
+		void finish();
+		void parseStream( std::istream& file );
+		void parseData( const char* begin, const char* end );
+		bool parseCompressed( const char* data, size_t size );
+
+		template<bool Profile>
+		void parseLines( const char* begin, const char* end );
+
+		template<bool Profile>
+		void parseLine( const char* line, const char* end );
+
+		template<bool Profile, typename Real>
+		bool readColor( const char* p, const char* end, const char* name, vec3<Real>& color );
+
+		template<bool Profile, typename Real>
+		bool readScalar( const char* p, const char* end, const char* name, Real& value );
+
+		// Store value in field of current table material, or send it
+		template<bool Profile>
+		void parseColor( const char* p, const char* end, const char* name, unsigned int statement,
+						 vec3f materialrecord::* field, sig::signal1<const vec3d&>* signal );
+
+		template<bool Profile>
+		void parseScalar( const char* p, const char* end, const char* name, unsigned int statement,
+						  float materialrecord::* field, sig::signal1<double>* signal );
+
+		template<bool Profile>
+		void parseTextureMap( const char* p, const char* end, texturemap::maptype type,
+							  sig::signal1<const std::string&>* signal );
+
+		template<bool Profile>
+		bool parseMapOption( const char*& p, const char* end, texturemap& map );
+
+		template<bool Profile>
+		void count( mtlstats::keyword keyword );
+
+		// Message is built in the line buffer, so repeated errors do not allocate
+		template<bool Profile>
+		void error( parsestats::errortype type, const char* message, const char* arg = 0, const char* argEnd = 0, const char* suffix = 0 );
+
+		// Send the line buffer as error
+		template<bool Profile>
+		void sendError( parsestats::errortype type );
 	};
 }
 
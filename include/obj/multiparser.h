@@ -0,0 +1,71 @@
+#ifndef _OBJ_MULTIPARSER_H_
+#define _OBJ_MULTIPARSER_H_
+
+#include <obj/objparser.h>
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Parses many OBJ files concurrently.
+	 *
+	 *	Worker threads map files and record their lines, large files are
+	 *	split at line breaks and their parts are taken by idle workers
+	 *	before any new file. The calling thread sends the signals of each
+	 *	file through parser part by part as soon as the next part is
+	 *	recorded, so files arrive in the order they were started, not the
+	 *	order given. Signals of one file are never mixed with those of
+	 *	another, and are the same as parser.parse( filename ) would send.
+	 *
+	 *	At most two parts per worker of a file are recorded ahead of the
+	 *	part being sent, so memory does not grow with file size. Recorded
+	 *	parts waiting to be sent hold back workers from starting new files
+	 *	once they add up to a few parts per worker.
+	 *
+	 *	Compressed files, files that cannot be mapped and all files when
+	 *	parser.cacheDirectory is set are parsed by parser on the calling
+	 *	thread when their turn comes.
+	 */
+	template<typename Real>
+	class basic_multiparser
+	{
+	public:
+		basic_multiparser();
+
+		void parse( const std::vector<std::string>& filenames );
+
+		// Sends the signals of every file, its flags apply to every file
+		basic_objparser<Real> parser;
+
+		/************************************************************************/
+		/* Parsing flags                                                        */
+		/************************************************************************/
+
+		// Worker threads recording files, in addition to the calling thread, 1 = parse files one after another
+		unsigned int numThreads; // default = 0, one per processor
+
+		/************************************************************************/
+		/* Parsing notifications                                                */
+		/* <index in filenames, ...>                                            */
+		/************************************************************************/
+
+		// Sent before the parser signals of a file
+		sig::signal2<unsigned int, const std::string&> fileBeginSignal;
+
+		// Sent after the last parser signal of a file
+		sig::signal1<unsigned int> fileEndSignal;
+
+	private:
+		// Non copyable
+		basic_multiparser( const basic_multiparser& );
+		basic_multiparser& operator=( const basic_multiparser& );
+
+		void parseSerial( const std::vector<std::string>& filenames );
+	};
+
+	typedef basic_multiparser<double> multiparser;
+	typedef basic_multiparser<float> multiparserf;
+}
+
+#endif // _OBJ_MULTIPARSER_H_
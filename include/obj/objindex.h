@@ -0,0 +1,108 @@
+#ifndef _OBJ_OBJINDEX_H_
+#define _OBJ_OBJINDEX_H_
+
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	template<typename Real> class basic_objparser;
+
+	/*
+	 *	Random access index of an OBJ file, to parse only some objects,
+	 *	groups or materials of it.
+	 *
+	 *	Records the byte offset, line number and number of vertices,
+	 *	texcoords and normals before each o, g, usemtl and mtllib line.
+	 *	Parsing a range starts from these counts, so negative indices and
+	 *	line numbers come out as in a parse of the whole file, and positive
+	 *	indices keep referring to vertices of the whole file.
+	 *
+	 *	The index is saved as a sidecar file next to the OBJ file, identified
+	 *	by the size and modification time of the OBJ file. Compressed files
+	 *	cannot be indexed.
+	 */
+	class objindex
+	{
+	public:
+		enum keyword
+		{
+			OBJECT_NAME,
+			GROUP_NAME,
+			MATERIAL_USE,
+			MATERIAL_LIB
+		};
+
+		// Line starting a section, with counts of everything before it
+		class entry
+		{
+		public:
+			keyword type;
+			std::string name;
+			unsigned long long offset;
+			unsigned int line;			// number of lines before
+			int numVertices;
+			int numTexCoords;
+			int numNormals;
+		};
+
+		// Lines from entry to byte offset end
+		class range
+		{
+		public:
+			unsigned int entry;
+			unsigned long long end;
+		};
+
+		objindex();
+
+		// Index file with one worker per thread, 0 = one per processor
+		bool build( const char* filename, unsigned int numThreads = 1 );
+
+		// Sidecar of filename, read if it matches the file, else built and written if possible
+		bool open( const char* filename, unsigned int numThreads = 1 );
+
+		// Read sidecar of filename, fails if it does not match the file
+		bool load( const char* filename );
+
+		// Write sidecar of indexed file
+		bool save() const;
+
+		static std::string sidecarFile( const char* filename );
+
+		const std::string& filename() const { return _filename; }
+		unsigned long long fileSize() const { return _fileSize; }
+		const std::vector<entry>& entries() const { return _entries; }
+
+		// Ranges of o lines with name until the next o
+		void findObject( const std::string& name, std::vector<range>& ranges ) const;
+
+		// Ranges of g lines with name until the next g or o
+		void findGroup( const std::string& name, std::vector<range>& ranges ) const;
+
+		// Ranges of usemtl lines with name until the next usemtl, g or o
+		void findMaterial( const std::string& name, std::vector<range>& ranges ) const;
+
+		/*
+		 *	Parse ranges in order as one parse. Before each range, the last o,
+		 *	g and usemtl lines preceding it and all mtllib lines before it are
+		 *	parsed again unless the range repeats them, so signals describe
+		 *	its faces as in the whole file.
+		 */
+		template<typename Real>
+		bool parse( basic_objparser<Real>& parser, const std::vector<range>& ranges ) const;
+
+	private:
+		void find( keyword type, const std::string& name, std::vector<range>& ranges ) const;
+
+		// Offset of next entry of a type in types, or end of file
+		unsigned long long sectionEnd( size_t i, const bool* types ) const;
+
+		std::string _filename;
+		unsigned long long _fileSize;
+		long long _fileTime;
+		std::vector<entry> _entries;
+	};
+}
+
+#endif // _OBJ_OBJINDEX_H_
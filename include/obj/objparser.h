@@ -2,26 +2,58 @@
 #define _OBJ_OBJPARSER_H_
 
 #include <obj/types.h>
+#include <obj/batchsink.h>
+#include <obj/parsestats.h>
+#include <obj/symboltable.h>
+#include <obj/arena.h>
+#include <obj/triangulator.h>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 namespace obj
 {
+	template<typename Handler, bool Profile> class objreader;
+	template<typename Real> class objchunk;
+	template<typename Real> class objcache;
+	template<typename Real> class basic_multiparser;
+	class mappedfile;
+	class objindex;
+
 	/*
 	 *	OBJ File format description:
 	 *	http://local.wasp.uwa.edu.au/~pbourke/dataformats/obj/
 	 *	
 	 *	Known issues:
-	 *		. w coordinate in vectors not supported
 	 *		. only reads first word from group name
 	 *		. only reads first word from material name
-	 *		. multiple material libraries not supported
+	 *		. mtllib sends all filenames in one string, see materialbinder
+	 *
+	 *	Real is the precision numbers are parsed to and vectors are sent
+	 *	with, see objparser and objparserf below.
 	 */
-	class objparser
+	template<typename Real>
+	class basic_objparser
 	{
 	public:
-		objparser();
+		typedef Real real_type;
+		typedef vec3<Real> vector_type;
+
+		basic_objparser();
 
+		// gzip and zstd files are decompressed while parsing, see README for build options
 		void parse( const char* filename );
 		void parse( std::istream& file );
+		void parse( const char* data, size_t size );
+
+		// Push parsing, data may be split anywhere and lines are parsed as soon as they are complete
+		void feed( const char* data, size_t size );
+
+		// Parse last line of fed data and end push parsing, next feed starts a new parse
+		void finish();
+
+		// Object, group and material names of current parse, cleared when the next one starts
+		const symboltable& names() const { return _names; }
 
 		/************************************************************************/
 		/* Parsing flags                                                        */
@@ -29,6 +61,36 @@ namespace obj
 
 		bool convertNegativeIndices; // default = true
 
+		// Report faces referring to elements not read yet as errors on their line and skip them, lines are then recorded in chunks
+		// Negative indices are out of range unless converted
+		bool checkIndices; // default = false
+
+		// Worker threads for large inputs, signals are still sent in file order from the calling thread
+		unsigned int numThreads; // default = 1, 0 = one per processor
+
+		// Send vertices, normals, texcoords and faces to sink in blocks instead of per element signals
+		basic_batchsink<Real>* batchSink; // default = 0
+
+		// Maximum number of elements (or faces) per block
+		unsigned int batchSize; // default = 4096
+
+		// Directory of binary parse caches, parse( filename ) replays the cache of an unchanged file instead of parsing it
+		std::string cacheDirectory; // default = empty, no caching
+
+		// Also compare file contents with the hash stored in cache, not only size and modification time
+		bool cacheCheckContent; // default = false
+
+		// Collect counts and times of each parse, lines are then recorded in chunks before being sent
+		objstats* stats; // default = 0
+
+		// Only chunks recorded on the calling thread are allocated here, rewound after each block, handlers must not use it
+		// Names, triangulation buffers and chunks of worker threads stay on the heap, the buffers are reused by the next parse
+		arena* memory; // default = 0, heap
+
+		// Split faces into triangles before sending them, fans for convex faces and ear clipping for others
+		// Vertex positions are kept until the parse ends, faces referring to vertices outside the parsed lines become fans
+		bool triangulate; // default = false
+
 		/************************************************************************/
 		/* Parsing notifications                                                */
 		/* <lineNumber, message>                                                */
@@ -45,13 +107,22 @@ namespace obj
 		/************************************************************************/
 
 		// Vertex
-		sig::signal1<const vec3d&> vertexSignal;
+		sig::signal1<const vector_type&> vertexSignal;
+
+		// Weight of a "v x y z w" line, sent after vertexSignal of its vertex (vertices without one have weight 1)
+		sig::signal1<Real> vertexWeightSignal;
+
+		// Color of a "v x y z r g b" line, sent after vertexSignal of its vertex
+		sig::signal1<const vector_type&> vertexColorSignal;
 
 		// Normal
-		sig::signal1<const vec3d&> normalSignal;
+		sig::signal1<const vector_type&> normalSignal;
 		
 		// Texture coordinate (default value is zero)
-		sig::signal1<const vec3d&> texcoordSignal;
+		sig::signal1<const vector_type&> texcoordSignal;
+
+		// Point in parameter space of curves and surfaces (default v is zero, default weight is one)
+		sig::signal1<const vector_type&> parameterSignal;
 
 		/************************************************************************/
 		/* Face indices                                                         */
@@ -75,6 +146,10 @@ namespace obj
 
 		sig::signal1<const std::string&> groupNameSignal;
 
+		// Names as IDs in names(), sent before the string signals
+		sig::signal1<unsigned int> objectNameIdSignal;
+		sig::signal1<unsigned int> groupNameIdSignal;
+
 		/************************************************************************/
 		/* Material information                                                 */
 		/************************************************************************/
@@ -85,15 +160,105 @@ namespace obj
 		// Use material 'name' for next primitives
 		sig::signal1<const std::string&> materialUseSignal;
 
+		// Material name as ID in names(), sent before materialUseSignal
+		sig::signal1<unsigned int> materialUseIdSignal;
+
+		/************************************************************************/
+		/* Shading                                                              */
+		/************************************************************************/
+
+		// Smoothing group of next primitives, 0 = off
+		sig::signal1<unsigned int> smoothingGroupSignal;
+
 	private:
+		friend class objreader<basic_objparser, false>;
+		friend class objchunk<Real>;
+		friend class objindex;
+		friend class basic_multiparser<Real>;
+
 		unsigned int _lineNumber;
 		int _numVertices;
 		int _numNormals;
 		int _numTexCoords;
 
+		// Cache being written by current parse
+		objcache<Real>* _cache;
+
+		// Start of current parse when collecting stats
+		double _startTime;
+
+		// Push parsing in progress and its incomplete last line
+		bool _feeding;
+		std::vector<char> _partialLine;
+
+		// Interned names and the string sent with them, reused so known names do not allocate
+		symboltable _names;
+		std::string _name;
+
+		// Vertices of current parse when triangulating
+		std::vector<vector_type> _positions;
+
+		// Face being read and corner positions of face being triangulated
+		std::vector<face_index> _face;
+		std::vector<vector_type> _corners;
+		basic_triangulator<Real> _triangulator;
+
+		// Triangles of faces sent to batch sink
+		std::vector<unsigned int> _triangleSizes;
+		std::vector<face_index> _triangleElements;
+
+		void reset();
+		void endParse();
+		unsigned int numWorkers() const;
+		void parseStream( std::istream& file );
+		void parseLines( const char* begin, const char* end );
+		void parseSerial( const char* begin, const char* end );
+		void parseParallel( const char* begin, const char* end );
+		void parseRecorded( const char* begin, const char* end );
+		void parseCached( const char* filename, const mappedfile& source );
+		bool parseCompressed( const char* data, size_t size );
+		void replayChunk( objchunk<Real>& chunk );
+
+		// Lines of a file starting after line lines and numVertices, numTexCoords and numNormals attributes
+		void parseSection( const char* begin, const char* end, unsigned int line, int numVertices, int numTexCoords, int numNormals );
+
 		void convertNegativeIndex( face_index& idx );
-		bool parseIndexTuple( face_index& idx, const std::string& elem );
+
+		// Face only refers to elements before it, given the counts read so far in the chunk being replayed
+		bool isInRange( const face_index* elements, unsigned int size, size_t numVertices, size_t numTexCoords, size_t numNormals ) const;
+		void rangeError( unsigned int line );
+
+		// Triangulation
+		void addPositions( const vector_type* v, size_t count );
+		void splitFace( const face_index* elements, unsigned int size );
+		void sendFace( const face_index* elements, unsigned int size );
+		void sendTriangles( const unsigned int* sizes, size_t numFaces, const face_index* elements );
+
+		// objreader handler
+		void nextLine();
+		void error( const std::string& message );
+		void comment( const std::string& text );
+		void vertex( const vector_type& v );
+		void weightedVertex( const vector_type& v, Real w );
+		void coloredVertex( const vector_type& v, const vector_type& color );
+		void normal( const vector_type& n );
+		void texcoord( const vector_type& t );
+		void parameter( const vector_type& p );
+		void faceBegin( unsigned int numElements );
+		void faceElement( face_index& idx );
+		void faceEnd();
+		void objectName( const char* name, const char* nameEnd );
+		void groupName( const char* name, const char* nameEnd );
+		void materialLib( const std::string& filename );
+		void materialUse( const char* name, const char* nameEnd );
+		void smoothingGroup( unsigned int group );
 	};
+
+	// Double precision parser
+	typedef basic_objparser<double> objparser;
+
+	// Single precision parser, parses numbers straight to float
+	typedef basic_objparser<float> objparserf;
 }
 
 #endif // _OBJ_OBJPARSER_H_
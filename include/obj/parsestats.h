@@ -0,0 +1,128 @@
+#ifndef _OBJ_PARSESTATS_H_
+#define _OBJ_PARSESTATS_H_
+
+namespace obj
+{
+	/*
+	 *	Statistics of a single parse, collected when a parser's stats
+	 *	pointer is set and cleared when the next parse starts.
+	 *
+	 *	Times are wall clock seconds. With worker threads, tokenizing and
+	 *	number conversion are summed over all workers. Number conversion
+	 *	is timed on a sample of lines and extrapolated, tokenizing is the
+	 *	rest of the time spent reading lines. Pages of mapped files are
+	 *	read on first access, that I/O counts as tokenizing.
+	 */
+	class parsestats
+	{
+	public:
+		enum errortype
+		{
+			MALFORMED_ERROR,		// value or name could not be read, skipped
+			EXTRA_DATA_ERROR,		// information beyond the expected values, ignored
+			UNKNOWN_KEYWORD_ERROR,
+			UNSUPPORTED_ERROR,		// options and syntax that are recognized but not supported
+			FILE_ERROR,				// file could not be opened or decompressed
+			NUM_ERROR_TYPES
+		};
+
+		parsestats();
+
+		void clear();
+
+		unsigned long long numBytes;
+		unsigned long long numLines;
+		unsigned long long numErrors[NUM_ERROR_TYPES];
+
+		double totalTime;
+		double ioTime;
+		double tokenizeTime;
+		double conversionTime;
+		double dispatchTime;
+
+	protected:
+		void merge( const parsestats& other );
+	};
+
+	class objstats : public parsestats
+	{
+	public:
+		enum keyword
+		{
+			VERTEX,
+			NORMAL,
+			TEXCOORD,
+			PARAMETER,
+			FACE,
+			OBJECT_NAME,
+			GROUP_NAME,
+			MATERIAL_LIB,
+			MATERIAL_USE,
+			SMOOTHING_GROUP,
+			COMMENT,
+			EMPTY,
+			UNKNOWN,
+			NUM_KEYWORDS
+		};
+
+		// Faces larger than this share the last histogram entry
+		enum
+		{
+			MAX_FACE_SIZE = 16
+		};
+
+		objstats();
+
+		void clear();
+
+		// Add counts and times of another parse or chunk
+		void merge( const objstats& other );
+
+		unsigned long long numKeywordLines[NUM_KEYWORDS];
+
+		// faceSizes[n] = number of faces with n elements
+		unsigned long long faceSizes[MAX_FACE_SIZE + 1];
+
+		// Face indices relative to the end of the lists read so far
+		unsigned long long numNegativeIndices;
+
+		// Faces split by ear clipping when triangulating, all others were convex and split as fans
+		unsigned long long numClippedFaces;
+
+		// Replayed from cache: only bytes and dispatch time are known
+		bool fromCache;
+	};
+
+	class mtlstats : public parsestats
+	{
+	public:
+		enum keyword
+		{
+			NEW_MATERIAL,
+			AMBIENT,
+			DIFFUSE,
+			SPECULAR,
+			OPACITY,
+			SPECULAR_EXPONENT,
+			REFRACTION_INDEX,
+			EMISSIVE,
+			TRANSMISSION_FILTER,
+			ILLUMINATION,
+			SHARPNESS,
+			PHYSICAL,
+			TEXTURE_MAP,
+			COMMENT,
+			EMPTY,
+			UNKNOWN,
+			NUM_KEYWORDS
+		};
+
+		mtlstats();
+
+		void clear();
+
+		unsigned long long numKeywordLines[NUM_KEYWORDS];
+	};
+}
+
+#endif // _OBJ_PARSESTATS_H_
@@ -0,0 +1,180 @@
+#ifndef _OBJ_SPATIALPARTITION_H_
+#define _OBJ_SPATIALPARTITION_H_
+
+#include <obj/types.h>
+#include <obj/batchsink.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	template<typename Real> class basic_objparser;
+
+	/*
+	 *	Out-of-core ingest: routes the geometry of a parse into the tiles of
+	 *	a uniform grid, written as binary files to a directory, so meshes
+	 *	larger than memory can be processed tile by tile.
+	 *
+	 *	Vertices belong to the cell containing their position. While parsing,
+	 *	attributes are spilled to temporary files in arrival order and faces
+	 *	are buffered per tile and appended to a temporary file of the tile;
+	 *	memory holds the tile of each vertex (4 bytes) and one face buffer
+	 *	per tile. finish() then writes each tile file in turn, with indices
+	 *	local to the tile.
+	 *
+	 *	A face whose vertices lie in several cells goes to the tiles chosen
+	 *	by facePolicy. Vertices, texcoords and normals a tile needs from
+	 *	other cells are copied into it, so every tile is self contained.
+	 *
+	 *	Temporary files are named after the process and the partition, so
+	 *	several partitions may share a directory. Tile files are named after
+	 *	their cell only, partitions writing the same cells need their own.
+	 */
+	template<typename Real>
+	class basic_spatialpartition : public basic_batchsink<Real>
+	{
+	public:
+		typedef vec3<Real> vector_type;
+
+		enum facepolicy
+		{
+			FIRST_VERTEX,	// face goes to the tile of its first vertex
+			EVERY_TILE		// face is copied to every tile holding one of its vertices
+		};
+
+		// Grid cell written to a file by finish()
+		class tile
+		{
+		public:
+			int x;
+			int y;
+			int z;
+			std::string filename;
+			unsigned int numPositions;
+			unsigned int numTexCoords;
+			unsigned int numNormals;
+			unsigned int numFaces;
+			unsigned int numFaceElements;
+		};
+
+		// Contents of a tile file, indices are 1 based and local to the tile, zero if not defined
+		class tiledata
+		{
+		public:
+			std::vector<vector_type> positions;
+			std::vector<vector_type> texcoords;
+			std::vector<vector_type> normals;
+			std::vector<unsigned int> faceSizes;
+			std::vector<face_index> faceElements;
+		};
+
+		// Files are created in directory, which must exist; cell (i, j, k) spans [i, i + 1) * cellSize on x, and so on
+		// cellSize must be positive and finite, otherwise finish() fails without writing tiles
+		basic_spatialpartition( const std::string& directory, Real cellSize );
+		~basic_spatialpartition();
+
+		// Send geometry of parser to this partition, parse, then call finish()
+		void connect( basic_objparser<Real>& parser );
+
+		// Write tile files and remove temporary files, false if any file could not be written
+		bool finish();
+
+		// Tiles written by finish(), in order of their first vertex
+		const std::vector<tile>& tiles() const { return _tiles; }
+
+		// Faces left out because they had no valid element or referenced attributes not defined before them
+		unsigned int numSkippedFaces() const { return _numSkippedFaces; }
+
+		static bool readTile( const std::string& filename, tiledata& data );
+
+		/************************************************************************/
+		/* Partitioning flags                                                   */
+		/************************************************************************/
+
+		facepolicy facePolicy; // default = FIRST_VERTEX
+
+		// Bytes of faces kept per tile before they are appended to its temporary file
+		size_t tileBufferSize; // default = 64 KB
+
+		/************************************************************************/
+		/* Batch sink                                                           */
+		/************************************************************************/
+
+		void vertices( const vector_type* v, size_t count );
+		void normals( const vector_type* n, size_t count );
+		void texcoords( const vector_type* t, size_t count );
+		void faces( const unsigned int* sizes, size_t numFaces, const face_index* elements, size_t numElements );
+
+	private:
+		// Non copyable
+		basic_spatialpartition( const basic_spatialpartition& );
+		basic_spatialpartition& operator=( const basic_spatialpartition& );
+
+		struct cell
+		{
+			int x;
+			int y;
+			int z;
+
+			bool operator<( const cell& other ) const
+			{
+				if( x != other.x )
+					return x < other.x;
+				if( y != other.y )
+					return y < other.y;
+				return z < other.z;
+			}
+		};
+
+		// Faces routed to a tile and not yet written: size, then size global face_index
+		struct facebuffer
+		{
+			std::vector<unsigned int> data;
+			unsigned int numFaces;
+			bool spilled;
+		};
+
+		unsigned int tileOf( const vector_type& v );
+		bool isValid( const face_index* face, unsigned int size ) const;
+		void route( unsigned int t, const face_index* face, unsigned int size );
+		void spill( unsigned int t );
+		bool writeTile( unsigned int t, const std::vector<unsigned int>& owned,
+						const char* positions, const char* texcoords, const char* normals );
+		std::string tempFile( const char* name ) const;
+		std::string facesFile( unsigned int t ) const;
+		void removeTempFiles();
+
+		std::string _directory;
+		Real _cellSize;
+
+		// Unique to this partition, so temporary files of others in directory are left alone
+		std::string _tempPrefix;
+
+		std::map<cell, unsigned int> _cells;
+		std::vector<tile> _tiles;
+		std::vector<facebuffer> _faces;
+
+		// Tile of each vertex in file order
+		std::vector<unsigned int> _vertexTiles;
+		unsigned int _numTexCoords;
+		unsigned int _numNormals;
+		unsigned int _numSkippedFaces;
+
+		// Last cell looked up, neighbouring vertices are usually in the same one
+		cell _lastCell;
+		unsigned int _lastTile;
+
+		// Attributes in file order
+		std::ofstream _positions;
+		std::ofstream _texcoords;
+		std::ofstream _normals;
+		bool _failed;
+	};
+
+	typedef basic_spatialpartition<double> spatialpartition;
+	typedef basic_spatialpartition<float> spatialpartitionf;
+}
+
+#endif // _OBJ_SPATIALPARTITION_H_
@@ -0,0 +1,75 @@
+#ifndef _OBJ_SYMBOLTABLE_H_
+#define _OBJ_SYMBOLTABLE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Interned names with consecutive IDs in order of first occurrence.
+	 *
+	 *	Text is stored once per name in large blocks that never move, so
+	 *	pointers returned by text() stay valid until clear(). Lookups hash
+	 *	the characters in place and do not allocate for known names.
+	 */
+	class symboltable
+	{
+	public:
+		symboltable();
+		~symboltable();
+
+		// Release all names, IDs start from zero again
+		void clear();
+
+		// ID of name, added if new
+		unsigned int intern( const char* begin, const char* end );
+		unsigned int intern( const std::string& name ) { return intern( name.data(), name.data() + name.size() ); }
+
+		// Null terminated text of name
+		const char* text( unsigned int id ) const { return _symbols[id].text; }
+		unsigned int length( unsigned int id ) const { return _symbols[id].length; }
+
+		std::string str( unsigned int id ) const { return std::string( text( id ), length( id ) ); }
+
+		unsigned int size() const { return (unsigned int)_symbols.size(); }
+
+	private:
+		// Non copyable
+		symboltable( const symboltable& );
+		symboltable& operator=( const symboltable& );
+
+		enum
+		{
+			EMPTY = 0xffffffff
+		};
+
+		struct symbol
+		{
+			const char* text;
+			unsigned int length;
+			unsigned int hash;
+		};
+
+		static unsigned int hash( const char* begin, const char* end );
+
+		// Copy text into current block, starting a new one when full
+		const char* store( const char* begin, const char* end );
+
+		void grow();
+
+		std::vector<symbol> _symbols;
+
+		// Open addressing table of IDs, linear probing and power of two size
+		std::vector<unsigned int> _slots;
+		size_t _mask;
+
+		// Text blocks, last one is being filled
+		std::vector<char*> _blocks;
+		size_t _blockUsed;
+		size_t _blockSize;
+	};
+}
+
+#endif // _OBJ_SYMBOLTABLE_H_
@@ -0,0 +1,61 @@
+#ifndef _OBJ_TRIANGULATOR_H_
+#define _OBJ_TRIANGULATOR_H_
+
+#include <obj/types.h>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Splits polygons into triangles.
+	 *
+	 *	Polygons are projected on the plane of their Newell normal, so
+	 *	non-planar ones are handled as well. Convex polygons become fans,
+	 *	others are split by ear clipping. Buffers are kept between
+	 *	polygons, only polygons larger than any before allocate.
+	 */
+	template<typename Real>
+	class basic_triangulator
+	{
+	public:
+		typedef vec3<Real> vector_type;
+
+		// Split polygon, false if it was not convex and needed ear clipping
+		bool triangulate( const vector_type* corners, unsigned int numCorners );
+
+		// Split polygon as a fan around its first corner
+		void fan( unsigned int numCorners );
+
+		// Corners of each triangle of the last polygon, 3 per triangle, numCorners - 2 triangles
+		const std::vector<unsigned int>& triangles() const { return _triangles; }
+
+	private:
+		// Twice the signed area of triangle of projected corners, positive if counterclockwise
+		Real area( unsigned int a, unsigned int b, unsigned int c ) const
+		{
+			const Real* pa = &_points[2 * a];
+			const Real* pb = &_points[2 * b];
+			const Real* pc = &_points[2 * c];
+			return ( pb[0] - pa[0] ) * ( pc[1] - pa[1] ) - ( pb[1] - pa[1] ) * ( pc[0] - pa[0] );
+		}
+
+		// Projected polygon counterclockwise, false if degenerate
+		bool project( const vector_type* corners, unsigned int numCorners );
+		bool isConvex( unsigned int numCorners ) const;
+		bool isEar( unsigned int prev, unsigned int i, unsigned int next ) const;
+		void clipEars( unsigned int numCorners );
+
+		// u, v of each corner
+		std::vector<Real> _points;
+
+		// Corners not clipped yet
+		std::vector<unsigned int> _remaining;
+
+		std::vector<unsigned int> _triangles;
+	};
+
+	typedef basic_triangulator<double> triangulator;
+	typedef basic_triangulator<float> triangulatorf;
+}
+
+#endif // _OBJ_TRIANGULATOR_H_
@@ -21,6 +21,8 @@ namespace obj
 
 	//////////////////////////////////////////////////////////////////////////
 	// 3-tuple container
+	//	Three consecutive T without padding and trivially copyable, arrays of
+	//	vec3 can be copied to buffers of T with memcpy
 	//////////////////////////////////////////////////////////////////////////
 	template<typename T>
 	class vec3
@@ -45,6 +47,12 @@ namespace obj
 	};
 
 	typedef vec3<double> vec3d;
+	typedef vec3<float> vec3f;
+
+	// Compile time layout checks, array size is negative if padding was added
+	typedef char vec3d_is_packed[sizeof( vec3d ) == 3 * sizeof( double ) ? 1 : -1];
+	typedef char vec3f_is_packed[sizeof( vec3f ) == 3 * sizeof( float ) ? 1 : -1];
+	typedef char face_index_is_packed[sizeof( face_index ) == 3 * sizeof( int ) ? 1 : -1];
 }
 
 #endif // _OBJ_TYPES_H_
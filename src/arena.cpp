@@ -0,0 +1,80 @@
+#include <obj/arena.h>
+#include <algorithm>
+
+using namespace obj;
+
+arena::arena( size_t blockSize )
+	: _blockSize( std::max( blockSize, (size_t)ALIGNMENT ) ), _current( 0 ), _used( 0 ), _blockEnd( 0 )
+{
+	// empty
+}
+
+arena::~arena()
+{
+	release();
+}
+
+arena::position arena::mark() const
+{
+	position p;
+	p.block = _current;
+	p.used = _used;
+	return p;
+}
+
+void arena::rewind( const position& mark )
+{
+	_current = mark.block;
+	_used = mark.used;
+	_blockEnd = ( _current < _blocks.size() ) ? _blocks[_current].size : 0;
+}
+
+void arena::reset()
+{
+	_current = 0;
+	_used = 0;
+	_blockEnd = _blocks.empty() ? 0 : _blocks[0].size;
+}
+
+void arena::release()
+{
+	for( size_t i = 0; i < _blocks.size(); ++i )
+		delete[] _blocks[i].data;
+
+	_blocks.clear();
+	_current = 0;
+	_used = 0;
+	_blockEnd = 0;
+}
+
+size_t arena::capacity() const
+{
+	size_t total = 0;
+	for( size_t i = 0; i < _blocks.size(); ++i )
+		total += _blocks[i].size;
+
+	return total;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+void* arena::allocateBlock( size_t size )
+{
+	// Current block is left unless nothing was allocated from it
+	const size_t next = ( _used == 0 ) ? _current : _current + 1;
+
+	// Keep a block too small for this request, insert a larger one before it
+	if( next >= _blocks.size() || _blocks[next].size < size )
+	{
+		block b;
+		b.size = std::max( size, _blockSize );
+		b.data = new char[b.size];
+		_blocks.insert( _blocks.begin() + next, b );
+	}
+
+	_current = next;
+	_used = size;
+	_blockEnd = _blocks[next].size;
+	return _blocks[next].data;
+}
@@ -0,0 +1,358 @@
+#include "decompressor.h"
+#include <algorithm>
+
+#ifdef OBJ_USE_ZLIB
+	#include <zlib.h>
+#endif
+
+#ifdef OBJ_USE_ZSTD
+	#include <zstd.h>
+#endif
+
+using namespace obj;
+
+struct decompressor::stream
+{
+#ifdef OBJ_USE_ZLIB
+	z_stream gzip;
+#endif
+
+#ifdef OBJ_USE_ZSTD
+	ZSTD_DStream* zstd;
+	ZSTD_inBuffer zstdInput;
+
+	// Nonzero while current frame is not complete
+	size_t zstdHint;
+#endif
+};
+
+decompressor::format decompressor::detect( const char* data, size_t size )
+{
+	const unsigned char* p = (const unsigned char*)data;
+
+	if( size >= 2 && p[0] == 0x1f && p[1] == 0x8b )
+		return GZIP;
+
+	if( size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd )
+		return ZSTD;
+
+	return NONE;
+}
+
+bool decompressor::isSupported( format f )
+{
+	switch( f )
+	{
+#ifdef OBJ_USE_ZLIB
+	case GZIP:
+		return true;
+#endif
+#ifdef OBJ_USE_ZSTD
+	case ZSTD:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* decompressor::name( format f )
+{
+	switch( f )
+	{
+	case GZIP:
+		return "gzip";
+	case ZSTD:
+		return "zstd";
+	default:
+		return "uncompressed";
+	}
+}
+
+decompressor::decompressor( const char* data, size_t size, format f, size_t blockSize )
+	: _format( f ), _input( data ), _inputEnd( data + size ), _stream( new stream() ), _finished( false ), _blockSize( blockSize ),
+	  _produced( 0 ), _consumed( 0 ), _reading( false ), _done( false ), _stop( false ), _threaded( false )
+{
+	if( !open() )
+	{
+		_done = true;
+		return;
+	}
+
+	_threaded = _thread.start( run, this );
+}
+
+decompressor::~decompressor()
+{
+	// Worker may be waiting for a free block
+	{
+		scoped_lock lock( _guard );
+		_stop = true;
+		_changed.notifyAll();
+	}
+
+	if( _threaded )
+		_thread.join();
+
+	close();
+	delete _stream;
+}
+
+bool decompressor::next( const char*& data, size_t& size )
+{
+	// Release previous block
+	{
+		scoped_lock lock( _guard );
+		if( _reading )
+		{
+			++_consumed;
+			_reading = false;
+			_changed.notifyAll();
+		}
+	}
+
+	if( !_threaded && !_done )
+		fillBlock();
+
+	scoped_lock lock( _guard );
+	while( _consumed == _produced && !_done )
+		_changed.wait( _guard );
+
+	if( _consumed == _produced )
+		return false;
+
+	const unsigned int slot = _consumed % NUM_BLOCKS;
+	data = &_blocks[slot][0];
+	size = _sizes[slot];
+	_reading = true;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+void decompressor::run( void* arg )
+{
+	decompressor& d = *(decompressor*)arg;
+
+	while( true )
+	{
+		// Wait until reader releases a block
+		{
+			scoped_lock lock( d._guard );
+			while( d._produced - d._consumed == NUM_BLOCKS && !d._stop )
+				d._changed.wait( d._guard );
+
+			if( d._stop )
+				return;
+		}
+
+		if( !d.fillBlock() )
+			return;
+	}
+}
+
+bool decompressor::open()
+{
+	switch( _format )
+	{
+#ifdef OBJ_USE_ZLIB
+	case GZIP:
+	{
+		// Window bits + 32 reads gzip and zlib headers
+		z_stream& z = _stream->gzip;
+		z.zalloc = Z_NULL;
+		z.zfree = Z_NULL;
+		z.opaque = Z_NULL;
+		z.next_in = Z_NULL;
+		z.avail_in = 0;
+
+		if( inflateInit2( &z, 15 + 32 ) != Z_OK )
+		{
+			_format = NONE;
+			_error = "cannot initialize zlib";
+			return false;
+		}
+		return true;
+	}
+#endif
+#ifdef OBJ_USE_ZSTD
+	case ZSTD:
+	{
+		_stream->zstd = ZSTD_createDStream();
+		if( !_stream->zstd || ZSTD_isError( ZSTD_initDStream( _stream->zstd ) ) )
+		{
+			if( _stream->zstd )
+				ZSTD_freeDStream( _stream->zstd );
+
+			_format = NONE;
+			_error = "cannot initialize zstd";
+			return false;
+		}
+
+		_stream->zstdInput.src = _input;
+		_stream->zstdInput.size = _inputEnd - _input;
+		_stream->zstdInput.pos = 0;
+		_stream->zstdHint = 1;
+		return true;
+	}
+#endif
+	default:
+		_error = std::string( "support for " ) + name( _format ) + " not built in";
+		_format = NONE;
+		return false;
+	}
+}
+
+void decompressor::close()
+{
+	switch( _format )
+	{
+#ifdef OBJ_USE_ZLIB
+	case GZIP:
+		inflateEnd( &_stream->gzip );
+		break;
+#endif
+#ifdef OBJ_USE_ZSTD
+	case ZSTD:
+		ZSTD_freeDStream( _stream->zstd );
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+bool decompressor::fillBlock()
+{
+	// Only the producer changes _produced
+	const unsigned int slot = _produced % NUM_BLOCKS;
+	std::vector<char>& block = _blocks[slot];
+
+	if( block.empty() )
+		block.resize( _blockSize );
+
+	size_t size = 0;
+	const bool ok = decompress( &block[0], block.size(), size );
+
+	scoped_lock lock( _guard );
+
+	if( size > 0 )
+	{
+		_sizes[slot] = size;
+		++_produced;
+	}
+
+	if( !ok || _finished )
+		_done = true;
+
+	_changed.notifyAll();
+	return !_done;
+}
+
+bool decompressor::decompress( char* out, size_t capacity, size_t& size )
+{
+	size = 0;
+
+	switch( _format )
+	{
+#ifdef OBJ_USE_ZLIB
+	case GZIP:
+	{
+		z_stream& z = _stream->gzip;
+		z.next_out = (Bytef*)out;
+		z.avail_out = (uInt)capacity;
+
+		while( z.avail_out > 0 )
+		{
+			// Hand input in pieces that fit zlib's 32 bit counts
+			if( z.avail_in == 0 && _input != _inputEnd )
+			{
+				const size_t piece = std::min<size_t>( _inputEnd - _input, 1 << 30 );
+				z.next_in = (Bytef*)_input;
+				z.avail_in = (uInt)piece;
+				_input += piece;
+			}
+
+			const int result = inflate( &z, Z_NO_FLUSH );
+
+			if( result == Z_STREAM_END )
+			{
+				// Concatenated members continue the same data
+				if( z.avail_in == 0 && _input == _inputEnd )
+				{
+					_finished = true;
+					break;
+				}
+
+				inflateReset( &z );
+				continue;
+			}
+
+			if( result != Z_OK )
+			{
+				size = capacity - z.avail_out;
+
+				if( result == Z_BUF_ERROR )
+					_error = "unexpected end of compressed data";
+				else
+					_error = z.msg ? z.msg : "corrupt compressed data";
+				return false;
+			}
+		}
+
+		size = capacity - z.avail_out;
+		return true;
+	}
+#endif
+#ifdef OBJ_USE_ZSTD
+	case ZSTD:
+	{
+		ZSTD_inBuffer& input = _stream->zstdInput;
+		ZSTD_outBuffer output;
+		output.dst = out;
+		output.size = capacity;
+		output.pos = 0;
+
+		while( output.pos < output.size )
+		{
+			const bool inputLeft = ( input.pos < input.size );
+
+			if( !inputLeft && _stream->zstdHint == 0 )
+			{
+				_finished = true;
+				break;
+			}
+
+			const size_t before = output.pos;
+			const size_t result = ZSTD_decompressStream( _stream->zstd, &output, &input );
+
+			if( ZSTD_isError( result ) )
+			{
+				size = output.pos;
+				_error = ZSTD_getErrorName( result );
+				return false;
+			}
+
+			// No more input and nothing left to flush
+			if( !inputLeft && result != 0 && output.pos == before )
+			{
+				size = output.pos;
+				_error = "unexpected end of compressed data";
+				return false;
+			}
+
+			_stream->zstdHint = result;
+		}
+
+		size = output.pos;
+		return true;
+	}
+#endif
+	default:
+		// Format without support built in
+		(void)out;
+		(void)capacity;
+		return false;
+	}
+}
@@ -0,0 +1,129 @@
+#ifndef _OBJ_DECOMPRESSOR_H_
+#define _OBJ_DECOMPRESSOR_H_
+
+#include "scanner.h"
+#include "thread.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Decompresses gzip or zstd data into a bounded ring of blocks on a
+	 *	worker thread, so lines of one block are parsed while the next ones
+	 *	are decompressed. Without a thread, blocks are decompressed on demand.
+	 *
+	 *	Formats are detected by magic bytes. Support for each is optional,
+	 *	define OBJ_USE_ZLIB and link zlib, define OBJ_USE_ZSTD and link zstd.
+	 */
+	class decompressor
+	{
+	public:
+		enum format
+		{
+			NONE,
+			GZIP,
+			ZSTD
+		};
+
+		// Compression format of data, from its first bytes
+		static format detect( const char* data, size_t size );
+
+		// Check if support for format was built in
+		static bool isSupported( format f );
+
+		static const char* name( format f );
+
+		// Start decompressing data, which must stay valid until destruction
+		decompressor( const char* data, size_t size, format f, size_t blockSize );
+		~decompressor();
+
+		// Next decompressed block, valid until the following call, false at end of data or on error
+		bool next( const char*& data, size_t& size );
+
+		// Hand lines of all decompressed data to parser, adds time spent waiting for blocks to readTime if set
+		template<typename Parser>
+		bool readLines( Parser& parser, void (Parser::*parseLines)( const char*, const char* ), double* readTime = 0 );
+
+		// Empty unless decompression failed
+		const std::string& error() const { return _error; }
+
+	private:
+		// Non copyable
+		decompressor( const decompressor& );
+		decompressor& operator=( const decompressor& );
+
+		enum
+		{
+			NUM_BLOCKS = 3
+		};
+
+		struct stream;
+
+		static void run( void* arg );
+
+		bool open();
+		void close();
+
+		// Decompress into next free block, false when there is nothing left
+		bool fillBlock();
+
+		// Decompress up to capacity bytes, false on error
+		bool decompress( char* out, size_t capacity, size_t& size );
+
+		format _format;
+		const char* _input;
+		const char* _inputEnd;
+		stream* _stream;
+		bool _finished;
+		size_t _blockSize;
+		std::string _error;
+
+		// Ring of blocks, [_consumed, _produced) are ready for reading
+		std::vector<char> _blocks[NUM_BLOCKS];
+		size_t _sizes[NUM_BLOCKS];
+		unsigned int _produced;
+		unsigned int _consumed;
+		bool _reading;
+		bool _done;
+		bool _stop;
+
+		mutex _guard;
+		condition _changed;
+		thread _thread;
+		bool _threaded;
+	};
+
+	template<typename Parser>
+	bool decompressor::readLines( Parser& parser, void (Parser::*parseLines)( const char*, const char* ), double* readTime )
+	{
+		std::vector<char> partialLine;
+
+		while( true )
+		{
+			const double start = readTime ? now() : 0.0;
+
+			const char* block;
+			size_t size;
+			const bool more = next( block, size );
+
+			if( readTime )
+				*readTime += now() - start;
+
+			if( !more )
+				break;
+
+			scanner::parseBlock( block, block + size, partialLine, parser, parseLines );
+		}
+
+		// Last line of truncated data is not parsed
+		if( !_error.empty() )
+			return false;
+
+		scanner::parseLastLine( partialLine, parser, parseLines );
+		return true;
+	}
+}
+
+#endif // _OBJ_DECOMPRESSOR_H_
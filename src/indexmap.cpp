@@ -0,0 +1,49 @@
+#include "indexmap.h"
+
+using namespace obj;
+
+// Initial number of slots
+static const size_t INITIAL_CAPACITY = 1024;
+
+indexmap::indexmap( arena* memory )
+	: _entries( memory )
+{
+	clear();
+}
+
+void indexmap::clear()
+{
+	entry empty;
+	empty.vertexIdx = 0;
+	empty.texCoordIdx = 0;
+	empty.normalIdx = 0;
+	empty.index = EMPTY;
+
+	_entries.assign( INITIAL_CAPACITY, empty );
+	_mask = INITIAL_CAPACITY - 1;
+	_size = 0;
+}
+
+void indexmap::grow()
+{
+	entryarray old( _entries.get_allocator() );
+	old.swap( _entries );
+
+	entry empty = old[0];
+	empty.index = EMPTY;
+
+	_entries.assign( old.size() * 2, empty );
+	_mask = _entries.size() - 1;
+
+	for( size_t i = 0; i < old.size(); ++i )
+	{
+		if( old[i].index == EMPTY )
+			continue;
+
+		size_t j = hash( old[i].vertexIdx, old[i].texCoordIdx, old[i].normalIdx ) & _mask;
+		while( _entries[j].index != EMPTY )
+			j = ( j + 1 ) & _mask;
+
+		_entries[j] = old[i];
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef _OBJ_INDEXMAP_H_
+#define _OBJ_INDEXMAP_H_
+
+#include <obj/types.h>
+#include <obj/arena.h>
+#include <vector>
+
+namespace obj
+{
+	/*
+	 *	Open addressing hash map from v/t/n index triples to output
+	 *	vertex indices, with linear probing and power of two capacity.
+	 */
+	class indexmap
+	{
+	public:
+		// Entries are allocated from memory if set
+		indexmap( arena* memory = 0 );
+
+		void clear();
+
+		// Find index of key, or add it with newIndex; inserted tells which
+		unsigned int insert( const face_index& key, unsigned int newIndex, bool& inserted )
+		{
+			// Keep load factor below one half
+			if( 2 * ( _size + 1 ) > _entries.size() )
+				grow();
+
+			size_t i = hash( key.vertexIdx, key.texCoordIdx, key.normalIdx ) & _mask;
+
+			while( true )
+			{
+				entry& e = _entries[i];
+
+				if( e.index == EMPTY )
+				{
+					e.vertexIdx = key.vertexIdx;
+					e.texCoordIdx = key.texCoordIdx;
+					e.normalIdx = key.normalIdx;
+					e.index = newIndex;
+					++_size;
+					inserted = true;
+					return newIndex;
+				}
+
+				if( e.vertexIdx == key.vertexIdx && e.texCoordIdx == key.texCoordIdx && e.normalIdx == key.normalIdx )
+				{
+					inserted = false;
+					return e.index;
+				}
+
+				i = ( i + 1 ) & _mask;
+			}
+		}
+
+		size_t size() const { return _size; }
+
+	private:
+		static const unsigned int EMPTY = 0xffffffffu;
+
+		struct entry
+		{
+			int vertexIdx;
+			int texCoordIdx;
+			int normalIdx;
+			unsigned int index;
+		};
+
+		static size_t hash( int vertexIdx, int texCoordIdx, int normalIdx )
+		{
+			// Pack the triple into 64 bits and mix
+			unsigned long long h = (unsigned long long)(unsigned int)vertexIdx * 0x9E3779B97F4A7C15ull;
+			h ^= ( (unsigned long long)(unsigned int)texCoordIdx << 32 | (unsigned int)normalIdx ) * 0xC2B2AE3D27D4EB4Full;
+			h ^= h >> 29;
+			return (size_t)h;
+		}
+
+		typedef std::vector< entry, arenaallocator<entry> > entryarray;
+
+		void grow();
+
+		entryarray _entries;
+		size_t _mask;
+		size_t _size;
+	};
+}
+
+#endif // _OBJ_INDEXMAP_H_
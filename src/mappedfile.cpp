@@ -0,0 +1,128 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace obj;
+
+mappedfile::mappedfile()
+	: _data( 0 ), _size( 0 )
+{
+	// empty
+}
+
+mappedfile::~mappedfile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool mappedfile::open( const char* filename )
+{
+	close();
+
+	HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if( GetFileType( file ) != FILE_TYPE_DISK || !GetFileSizeEx( file, &size ) ||
+		(unsigned long long)size.QuadPart > (size_t)-1 )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	// Empty files cannot be mapped but are valid input
+	if( size.QuadPart == 0 )
+	{
+		CloseHandle( file );
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMapping( file, 0, PAGE_READONLY, 0, 0, 0 );
+	CloseHandle( file );
+
+	if( !mapping )
+		return false;
+
+	void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+
+	if( !view )
+		return false;
+
+	_data = (const char*)view;
+	_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void mappedfile::close()
+{
+	if( _data )
+		UnmapViewOfFile( _data );
+
+	_data = 0;
+	_size = 0;
+}
+
+#else
+
+bool mappedfile::open( const char* filename )
+{
+	close();
+
+	int fd = ::open( filename, O_RDONLY );
+	if( fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ||
+		(unsigned long long)st.st_size > (size_t)-1 )
+	{
+		::close( fd );
+		return false;
+	}
+
+	// Empty files cannot be mapped but are valid input
+	if( st.st_size == 0 )
+	{
+		::close( fd );
+		return true;
+	}
+
+	void* view = mmap( 0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+
+	if( view == MAP_FAILED )
+		return false;
+
+	// Parsers read front to back exactly once
+#ifdef MADV_SEQUENTIAL
+	madvise( view, (size_t)st.st_size, MADV_SEQUENTIAL );
+#endif
+
+	_data = (const char*)view;
+	_size = (size_t)st.st_size;
+	return true;
+}
+
+void mappedfile::close()
+{
+	if( _data )
+		munmap( (void*)_data, _size );
+
+	_data = 0;
+	_size = 0;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _OBJ_MAPPEDFILE_H_
+#define _OBJ_MAPPEDFILE_H_
+
+#include <cstddef>
+
+namespace obj
+{
+	/*
+	 *	Read-only memory mapping of a whole regular file.
+	 *
+	 *	open() fails for anything that cannot be mapped (pipes, devices,
+	 *	files too large for the address space), callers are expected to
+	 *	fall back to stream input in that case.
+	 */
+	class mappedfile
+	{
+	public:
+		mappedfile();
+		~mappedfile();
+
+		bool open( const char* filename );
+		void close();
+
+		const char* data() const { return _data; }
+		size_t size() const { return _size; }
+
+	private:
+		// Non copyable
+		mappedfile( const mappedfile& );
+		mappedfile& operator=( const mappedfile& );
+
+		const char* _data;
+		size_t _size;
+	};
+}
+
+#endif // _OBJ_MAPPEDFILE_H_
@@ -0,0 +1,385 @@
+#include <obj/materiallibrary.h>
+#include <obj/mtlparser.h>
+#include "scanner.h"
+#include "thread.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace obj;
+
+namespace
+{
+	// Parses one library into its table
+	class mtlreader : public sig::has_slots<>
+	{
+	public:
+		void parse( const std::string& path, materialtable& table )
+		{
+			mtlparser parser;
+			parser.stats = &stats;
+			parser.table = &table;
+
+			parser.errorSignal.connect( this, &mtlreader::error_slot );
+			parser.parse( path.c_str() );
+		}
+
+		// File could not be opened if nothing was read
+		bool isFound() const
+		{
+			return stats.numErrors[parsestats::FILE_ERROR] == 0 || stats.numBytes > 0;
+		}
+
+		materiallibrary::errorlist errors;
+		mtlstats stats;
+
+	private:
+		void error_slot( unsigned int lineNumber, const std::string& message )
+		{
+			errors.push_back( std::make_pair( lineNumber, message ) );
+		}
+	};
+
+	// Orders material indices of a table by name, then by definition
+	class nameorder
+	{
+	public:
+		nameorder( const materialtable& table )
+			: _table( table )
+		{
+			// empty
+		}
+
+		int compare( unsigned int a, unsigned int b ) const
+		{
+			return strcmp( _table.text( _table.materials()[a].name ), _table.text( _table.materials()[b].name ) );
+		}
+
+		bool operator()( unsigned int a, unsigned int b ) const
+		{
+			const int order = compare( a, b );
+			return order < 0 || ( order == 0 && a < b );
+		}
+
+	private:
+		const materialtable& _table;
+	};
+
+	// Remove . and dir/.. so one file has one path, keeps drive letter or leading separator
+	std::string normalize( const std::string& path )
+	{
+		std::string::size_type start = 0;
+		if( path.size() > 1 && path[1] == ':' )
+			start = 2;
+		while( start < path.size() && ( path[start] == '/' || path[start] == '\\' ) )
+			++start;
+
+		std::vector<std::string> parts;
+		std::string::size_type p = start;
+		while( p <= path.size() )
+		{
+			std::string::size_type next = path.find_first_of( "/\\", p );
+			if( next == std::string::npos )
+				next = path.size();
+
+			const std::string part = path.substr( p, next - p );
+
+			if( part == ".." && !parts.empty() && parts.back() != ".." )
+				parts.pop_back();
+			else if( !part.empty() && part != "." && !( part == ".." && start > 0 ) )
+				parts.push_back( part );
+
+			p = next + 1;
+		}
+
+		std::string result = path.substr( 0, start );
+		for( size_t i = 0; i < parts.size(); ++i )
+		{
+			if( i > 0 )
+				result += '/';
+			result += parts[i];
+		}
+
+		return result;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materiallibrary
+//////////////////////////////////////////////////////////////////////////
+materiallibrary::materiallibrary()
+	: _guard( new mutex() ), _loaded( new condition() )
+{
+	// empty
+}
+
+materiallibrary::~materiallibrary()
+{
+	delete _loaded;
+	delete _guard;
+}
+
+std::string materiallibrary::resolve( const std::string& objFilename, const std::string& filename )
+{
+	// Absolute, including drive letters and network paths
+	if( filename.empty() || filename[0] == '/' || filename[0] == '\\' || ( filename.size() > 1 && filename[1] == ':' ) )
+		return normalize( filename );
+
+	const std::string::size_type slash = objFilename.find_last_of( "/\\" );
+	if( slash == std::string::npos )
+		return normalize( filename );
+
+	return normalize( objFilename.substr( 0, slash + 1 ) + filename );
+}
+
+unsigned int materiallibrary::load( const std::string& path )
+{
+	unsigned int index;
+	{
+		scoped_lock lock( *_guard );
+
+		std::map<std::string, unsigned int>::const_iterator it = _paths.find( path );
+		if( it != _paths.end() )
+		{
+			// Wait if another load is parsing it
+			while( !_libraries[it->second].loaded )
+				_loaded->wait( *_guard );
+
+			return it->second;
+		}
+
+		index = _libraries.size();
+		_libraries.append().path = path;
+		_paths[path] = index;
+	}
+
+	// Parse without holding the lock, so other libraries load concurrently, nobody reads the entry before it is loaded
+	entry& e = _libraries[index];
+	mtlreader reader;
+	try
+	{
+		reader.parse( path, e.table );
+	}
+	catch( ... )
+	{
+		// Release waiting loads, library stays empty
+		e.table.clear();
+
+		scoped_lock lock( *_guard );
+		e.firstId = _materialLibraries.size();
+		e.loaded = true;
+		_loaded->notifyAll();
+		throw;
+	}
+
+	// Sorted by name, only the last definition of each name is kept
+	const nameorder order( e.table );
+	for( unsigned int i = 0; i < e.table.numMaterials(); ++i )
+		e.byName.push_back( i );
+
+	std::sort( e.byName.begin(), e.byName.end(), order );
+
+	std::vector<unsigned int>::iterator last = e.byName.begin();
+	for( std::vector<unsigned int>::iterator it = e.byName.begin(); it != e.byName.end(); ++it )
+	{
+		if( it + 1 != e.byName.end() && order.compare( *it, *( it + 1 ) ) == 0 )
+			continue;
+
+		*last++ = *it;
+	}
+	e.byName.erase( last, e.byName.end() );
+
+	e.found = reader.isFound();
+	e.errors.swap( reader.errors );
+
+	scoped_lock lock( *_guard );
+	e.firstId = _materialLibraries.size();
+
+	for( unsigned int i = 0; i < e.table.numMaterials(); ++i )
+		_materialLibraries.append() = index;
+
+	e.loaded = true;
+	_loaded->notifyAll();
+	return index;
+}
+
+bool materiallibrary::isFound( unsigned int library ) const
+{
+	return _libraries[library].found;
+}
+
+const materiallibrary::errorlist& materiallibrary::errors( unsigned int library ) const
+{
+	return _libraries[library].errors;
+}
+
+const materialtable& materiallibrary::table( unsigned int library ) const
+{
+	return _libraries[library].table;
+}
+
+unsigned int materiallibrary::firstMaterial( unsigned int library ) const
+{
+	return _libraries[library].firstId;
+}
+
+unsigned int materiallibrary::find( unsigned int library, const std::string& name ) const
+{
+	return find( library, name.c_str() );
+}
+
+unsigned int materiallibrary::find( unsigned int library, const char* name ) const
+{
+	const entry& e = _libraries[library];
+	const materialrecord* materials = e.table.materials();
+
+	// Binary search of the sorted names
+	size_t begin = 0;
+	size_t end = e.byName.size();
+
+	while( begin < end )
+	{
+		const size_t middle = begin + ( end - begin ) / 2;
+		const int order = strcmp( e.table.text( materials[e.byName[middle]].name ), name );
+
+		if( order == 0 )
+			return e.firstId + e.byName[middle];
+
+		if( order < 0 )
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return NOT_FOUND;
+}
+
+const materialrecord& materiallibrary::get( unsigned int id ) const
+{
+	const entry& e = _libraries[_materialLibraries[id]];
+	return e.table.materials()[id - e.firstId];
+}
+
+const char* materiallibrary::name( unsigned int id ) const
+{
+	return _libraries[_materialLibraries[id]].table.text( get( id ).name );
+}
+
+unsigned int materiallibrary::library( unsigned int id ) const
+{
+	return _materialLibraries[id];
+}
+
+unsigned int materiallibrary::numMaterials() const
+{
+	scoped_lock lock( *_guard );
+	return _materialLibraries.size();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materiallibrary::pagedarray
+//////////////////////////////////////////////////////////////////////////
+template<typename T>
+materiallibrary::pagedarray<T>::pagedarray()
+	: _size( 0 )
+{
+	for( unsigned int k = 0; k < NUM_PAGES; ++k )
+		_pages[k] = 0;
+}
+
+template<typename T>
+materiallibrary::pagedarray<T>::~pagedarray()
+{
+	for( unsigned int k = 0; k < NUM_PAGES; ++k )
+		delete[] _pages[k];
+}
+
+template<typename T>
+T& materiallibrary::pagedarray<T>::append()
+{
+	// Pages are allocated once and never move, unlike the elements of a growing vector
+	const unsigned int k = pageIndex( _size );
+	if( !_pages[k] )
+		_pages[k] = new T[FIRST_PAGE_SIZE << k];
+
+	return ( *this )[_size++];
+}
+
+template<typename T>
+unsigned int materiallibrary::pagedarray<T>::pageIndex( unsigned int i )
+{
+	const unsigned long long j = (unsigned long long)i + FIRST_PAGE_SIZE;
+
+	unsigned int k = 0;
+	while( j >= ( (unsigned long long)FIRST_PAGE_SIZE << ( k + 1 ) ) )
+		++k;
+
+	return k;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materiallibrary::entry
+//////////////////////////////////////////////////////////////////////////
+materiallibrary::entry::entry()
+	: loaded( false ), found( false ), firstId( 0 )
+{
+	// empty
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materialbinder
+//////////////////////////////////////////////////////////////////////////
+materialbinder::materialbinder( materiallibrary& library, const std::string& objFilename )
+	: _library( library ), _objFilename( objFilename ), _current( materiallibrary::NOT_FOUND )
+{
+	// empty
+}
+
+unsigned int materialbinder::find( const std::string& name ) const
+{
+	for( size_t i = 0; i < _used.size(); ++i )
+	{
+		const unsigned int id = _library.find( _used[i], name );
+		if( id != materiallibrary::NOT_FOUND )
+			return id;
+	}
+
+	return materiallibrary::NOT_FOUND;
+}
+
+void materialbinder::materialLib_slot( const std::string& filenames )
+{
+	// One or more filenames separated by whitespace
+	const char* p = filenames.c_str();
+	const char* end = p + filenames.size();
+
+	for( p = scanner::skipSpace( p, end ); p != end; p = scanner::skipSpace( p, end ) )
+	{
+		const char* word = p;
+		p = scanner::skipToken( p, end );
+
+		const std::string path = materiallibrary::resolve( _objFilename, std::string( word, p ) );
+		const unsigned int library = _library.load( path );
+
+		// Already referenced by this file
+		if( std::find( _used.begin(), _used.end(), library ) != _used.end() )
+			continue;
+
+		_used.push_back( library );
+
+		if( !_library.isFound( library ) )
+		{
+			errorSignal.send( 0, "Cannot open material library '" + path + "'." );
+			continue;
+		}
+
+		const materiallibrary::errorlist& errors = _library.errors( library );
+		for( size_t i = 0; i < errors.size(); ++i )
+			errorSignal.send( errors[i].first, path + ": " + errors[i].second );
+	}
+}
+
+void materialbinder::materialUse_slot( const std::string& name )
+{
+	_current = find( name );
+	materialSignal.send( _current );
+}
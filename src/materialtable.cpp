@@ -0,0 +1,120 @@
+#include <obj/materialtable.h>
+#include <cstring>
+
+using namespace obj;
+
+//////////////////////////////////////////////////////////////////////////
+// texturemap
+//////////////////////////////////////////////////////////////////////////
+texturemap::texturemap()
+	: filename( 0 ), type( DIFFUSE ), flags( BLEND_U | BLEND_V ), channel( CHANNEL_DEFAULT ),
+	  projection( PROJECTION_DEFAULT ), resolution( 0 ), bumpMultiplier( 1.0f ), boost( 0.0f ),
+	  base( 0.0f ), gain( 1.0f )
+{
+	scale.set( 1.0f );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materialrecord
+//////////////////////////////////////////////////////////////////////////
+materialrecord::materialrecord()
+	: name( 0 ), given( 0 ), illumination( 0 ), specularExp( 0.0f ), opacity( 1.0f ), refractionIndex( 1.0f ),
+	  sharpness( 60.0f ), roughness( 0.0f ), metallic( 0.0f ), sheen( 0.0f ), clearcoat( 0.0f ),
+	  clearcoatRoughness( 0.0f ), anisotropy( 0.0f ), anisotropyRotation( 0.0f ), firstMap( 0 ), numMaps( 0 )
+{
+	transmission.set( 1.0f );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// materialtable
+//////////////////////////////////////////////////////////////////////////
+materialtable::materialtable()
+{
+	clear();
+}
+
+void materialtable::clear()
+{
+	_materials.clear();
+	_maps.clear();
+	_text.clear();
+	_block.clear();
+
+	_numMaterials = 0;
+	_numMaps = 0;
+	_mapsOffset = 0;
+	_textOffset = 0;
+}
+
+unsigned int materialtable::find( const char* name ) const
+{
+	// Tables are small, newest definition first
+	for( unsigned int i = _numMaterials; i > 0; --i )
+	{
+		if( strcmp( text( materials()[i - 1].name ), name ) == 0 )
+			return i - 1;
+	}
+
+	return NOT_FOUND;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+materialrecord& materialtable::beginMaterial( const char* name, const char* nameEnd )
+{
+	_materials.push_back( materialrecord() );
+
+	materialrecord& m = _materials.back();
+	m.name = addText( name, nameEnd );
+	m.firstMap = (unsigned int)_maps.size();
+	return m;
+}
+
+texturemap& materialtable::addMap( const texturemap& map, const char* filename, const char* filenameEnd )
+{
+	// Lines of a material are consecutive, so are its maps
+	++_materials.back().numMaps;
+
+	_maps.push_back( map );
+	_maps.back().filename = addText( filename, filenameEnd );
+	return _maps.back();
+}
+
+unsigned int materialtable::addText( const char* begin, const char* end )
+{
+	const unsigned int offset = (unsigned int)_text.size();
+	_text.insert( _text.end(), begin, end );
+	_text.push_back( '\0' );
+	return offset;
+}
+
+void materialtable::pack()
+{
+	const size_t materialsSize = _materials.size() * sizeof( materialrecord );
+	const size_t mapsSize = _maps.size() * sizeof( texturemap );
+	const size_t total = materialsSize + mapsSize + _text.size();
+
+	std::vector<unsigned int> block( ( total + sizeof( unsigned int ) - 1 ) / sizeof( unsigned int ) );
+	char* p = block.empty() ? 0 : (char*)&block[0];
+
+	if( !_materials.empty() )
+		memcpy( p, &_materials[0], materialsSize );
+
+	if( !_maps.empty() )
+		memcpy( p + materialsSize, &_maps[0], mapsSize );
+
+	if( !_text.empty() )
+		memcpy( p + materialsSize + mapsSize, &_text[0], _text.size() );
+
+	_block.swap( block );
+	_numMaterials = (unsigned int)_materials.size();
+	_numMaps = (unsigned int)_maps.size();
+	_mapsOffset = materialsSize;
+	_textOffset = materialsSize + mapsSize;
+
+	// Staging memory is not needed anymore
+	std::vector<materialrecord>().swap( _materials );
+	std::vector<texturemap>().swap( _maps );
+	std::vector<char>().swap( _text );
+}
@@ -0,0 +1,407 @@
+#include <obj/meshloader.h>
+#include <obj/objparser.h>
+#include <obj/materiallibrary.h>
+#include <obj/meshnormals.h>
+#include <obj/meshoptimizer.h>
+#include "indexmap.h"
+#include <map>
+
+using namespace obj;
+
+namespace
+{
+	template<typename Array>
+	void releaseArray( Array& a )
+	{
+		Array( a.get_allocator() ).swap( a );
+	}
+
+	// Arena memory may be rewound after clear(), so arena arrays are released instead of kept
+	template<typename Array>
+	void clearArray( Array& a )
+	{
+		if( a.get_allocator().memory() )
+			releaseArray( a );
+		else
+			a.clear();
+	}
+
+	// Builds the mesh from parser batches
+	class meshbuilder : public batchsinkf, public sig::has_slots<>
+	{
+	public:
+		meshbuilder( meshloader& loader, indexedmesh& mesh, const std::string& filename )
+			: _loader( loader ), _mesh( mesh ), _binder( 0 ),
+			  _positions( loader.memory ), _texcoords( loader.memory ), _normals( loader.memory ), _map( loader.memory ),
+			  _smoothingKey( SMOOTH_DEFAULT ), _hasMissingNormals( false ), _generatedNormals( loader.memory )
+		{
+			if( _loader.materials )
+				_binder = new materialbinder( *_loader.materials, filename );
+
+			// First part uses no material until usemtl says otherwise
+			indexedmesh::part p;
+			p.materialId = materiallibrary::NOT_FOUND;
+			p.firstIndex = 0;
+			p.numIndices = 0;
+			_mesh.parts.push_back( p );
+		}
+
+		~meshbuilder()
+		{
+			delete _binder;
+		}
+
+		void connect( objparserf& parser )
+		{
+			parser.errorSignal.connect( this, &meshbuilder::error_slot );
+			parser.materialUseSignal.connect( this, &meshbuilder::materialUse_slot );
+			parser.batchSink = this;
+
+			if( _loader.generateNormals )
+				parser.smoothingGroupSignal.connect( this, &meshbuilder::smoothingGroup_slot );
+
+			// Library errors are reported with their line in the library
+			if( _binder )
+			{
+				parser.materialLibSignal.connect( _binder, &materialbinder::materialLib_slot );
+				_binder->errorSignal.connect( this, &meshbuilder::error_slot );
+			}
+		}
+
+		// Packed vec3f, copied as consecutive floats
+		void vertices( const vec3f* v, size_t count )
+		{
+			const float* p = &v->x;
+			_positions.insert( _positions.end(), p, p + 3 * count );
+		}
+
+		void normals( const vec3f* n, size_t count )
+		{
+			const float* p = &n->x;
+			_normals.insert( _normals.end(), p, p + 3 * count );
+		}
+
+		void texcoords( const vec3f* t, size_t count )
+		{
+			for( size_t i = 0; i < count; ++i )
+			{
+				_texcoords.push_back( t[i].x );
+				_texcoords.push_back( t[i].y );
+			}
+		}
+
+		void faces( const unsigned int* sizes, size_t numFaces, const face_index* elements, size_t /*numElements*/ )
+		{
+			for( size_t f = 0; f < numFaces; ++f )
+			{
+				const face_index* face = elements;
+				const unsigned int size = sizes[f];
+				elements += size;
+
+				// Points and lines
+				if( size < 3 )
+					continue;
+
+				// Faces arrive triangulated, fan of what is left
+				const unsigned int first = faceVertex( face[0] );
+				unsigned int previous = faceVertex( face[1] );
+
+				for( unsigned int i = 2; i < size; ++i )
+				{
+					const unsigned int current = faceVertex( face[i] );
+
+					_mesh.indices.push_back( first );
+					_mesh.indices.push_back( previous );
+					_mesh.indices.push_back( current );
+
+					previous = current;
+				}
+			}
+		}
+
+		void finish( bool interleaved );
+
+		void error_slot( unsigned int lineNumber, const std::string& message )
+		{
+			_loader.errorSignal.send( lineNumber, message );
+		}
+
+		void materialUse_slot( const std::string& name )
+		{
+			const unsigned int numIndices = (unsigned int)_mesh.indices.size();
+			const unsigned int id = _binder ? _binder->find( name ) : (unsigned int)materiallibrary::NOT_FOUND;
+
+			// Reuse last part if it has no triangles yet
+			if( _mesh.parts.back().firstIndex == numIndices )
+			{
+				_mesh.parts.back().material = name;
+				_mesh.parts.back().materialId = id;
+				return;
+			}
+
+			indexedmesh::part p;
+			p.material = name;
+			p.materialId = id;
+			p.firstIndex = numIndices;
+			p.numIndices = 0;
+			_mesh.parts.push_back( p );
+		}
+
+		void smoothingGroup_slot( unsigned int group )
+		{
+			if( group == 0 )
+			{
+				_smoothingKey = SMOOTH_OFF;
+				return;
+			}
+
+			// Dense keys in order of first use
+			const int next = SMOOTH_DEFAULT + 1 + (int)_smoothingKeys.size();
+			_smoothingKey = _smoothingKeys.insert( std::make_pair( group, next ) ).first->second;
+		}
+
+	private:
+		// Keys of vertices without vn, stored as negative normal index
+		enum
+		{
+			SMOOTH_OFF = 0,
+			SMOOTH_DEFAULT = 1
+		};
+
+		unsigned int faceVertex( const face_index& idx )
+		{
+			if( !_loader.generateNormals || idx.normalIdx != 0 )
+				return vertexIndex( idx );
+
+			_hasMissingNormals = true;
+
+			// Not shared with other faces
+			if( _smoothingKey == SMOOTH_OFF )
+				return addVertex( idx );
+
+			face_index key = idx;
+			key.normalIdx = -_smoothingKey;
+			return vertexIndex( key );
+		}
+
+		unsigned int vertexIndex( const face_index& idx )
+		{
+			bool inserted;
+			const unsigned int index = _map.insert( idx, _mesh.numVertices, inserted );
+
+			if( !inserted )
+				return index;
+
+			return addVertex( idx );
+		}
+
+		unsigned int addVertex( const face_index& idx )
+		{
+			const float* p = &_positions[3 * ( idx.vertexIdx - 1 )];
+			_mesh.positions.insert( _mesh.positions.end(), p, p + 3 );
+
+			if( idx.texCoordIdx > 0 )
+			{
+				const float* t = &_texcoords[2 * ( idx.texCoordIdx - 1 )];
+				_mesh.texcoords.insert( _mesh.texcoords.end(), t, t + 2 );
+				_mesh.hasTexCoords = true;
+			}
+			else
+			{
+				_mesh.texcoords.resize( _mesh.texcoords.size() + 2, 0.0f );
+			}
+
+			if( idx.normalIdx > 0 )
+			{
+				const float* n = &_normals[3 * ( idx.normalIdx - 1 )];
+				_mesh.normals.insert( _mesh.normals.end(), n, n + 3 );
+				_mesh.hasNormals = true;
+			}
+			else
+			{
+				_mesh.normals.resize( _mesh.normals.size() + 3, 0.0f );
+			}
+
+			if( _loader.generateNormals )
+				_generatedNormals.push_back( idx.normalIdx <= 0 );
+
+			return _mesh.numVertices++;
+		}
+
+		meshloader& _loader;
+		indexedmesh& _mesh;
+
+		// Resolves usemtl when loader has a material library
+		materialbinder* _binder;
+
+		// Attributes as read from file
+		indexedmesh::floatarray _positions;
+		indexedmesh::floatarray _texcoords;
+		indexedmesh::floatarray _normals;
+
+		indexmap _map;
+
+		// Current smoothing group and keys of those seen
+		int _smoothingKey;
+		std::map<unsigned int, int> _smoothingKeys;
+
+		// Some vertex needs a generated normal, and for each vertex whether it had no vn
+		bool _hasMissingNormals;
+		std::vector< unsigned char, arenaallocator<unsigned char> > _generatedNormals;
+	};
+
+	void meshbuilder::finish( bool interleaved )
+	{
+		std::vector<indexedmesh::part>& parts = _mesh.parts;
+
+		// Close parts and drop those without triangles
+		size_t numParts = 0;
+		for( size_t i = 0; i < parts.size(); ++i )
+		{
+			const size_t end = ( i + 1 < parts.size() ) ? parts[i + 1].firstIndex : _mesh.indices.size();
+			parts[i].numIndices = (unsigned int)( end - parts[i].firstIndex );
+
+			if( parts[i].numIndices > 0 )
+				parts[numParts++] = parts[i];
+		}
+		parts.resize( numParts );
+
+		meshnormals shading;
+		shading.angleWeighted = _loader.angleWeightedNormals;
+		shading.numThreads = _loader.numThreads;
+
+		if( _hasMissingNormals )
+			shading.computeNormals( _mesh, &_generatedNormals[0] );
+
+		if( _loader.generateTangents )
+			shading.computeTangents( _mesh );
+
+		if( !_mesh.hasTexCoords )
+			releaseArray( _mesh.texcoords );
+
+		if( !_mesh.hasNormals )
+			releaseArray( _mesh.normals );
+
+		if( _loader.optimize )
+			meshoptimizer().optimize( _mesh );
+
+		if( !interleaved )
+			return;
+
+		const unsigned int stride = 3 + ( _mesh.hasTexCoords ? 2 : 0 ) + ( _mesh.hasNormals ? 3 : 0 ) + ( _mesh.hasTangents ? 4 : 0 );
+		_mesh.vertexStride = stride;
+		_mesh.vertices.resize( (size_t)stride * _mesh.numVertices );
+
+		for( unsigned int i = 0; i < _mesh.numVertices; ++i )
+		{
+			float* v = &_mesh.vertices[(size_t)stride * i];
+
+			v[0] = _mesh.positions[3 * i + 0];
+			v[1] = _mesh.positions[3 * i + 1];
+			v[2] = _mesh.positions[3 * i + 2];
+			v += 3;
+
+			if( _mesh.hasTexCoords )
+			{
+				v[0] = _mesh.texcoords[2 * i + 0];
+				v[1] = _mesh.texcoords[2 * i + 1];
+				v += 2;
+			}
+
+			if( _mesh.hasNormals )
+			{
+				v[0] = _mesh.normals[3 * i + 0];
+				v[1] = _mesh.normals[3 * i + 1];
+				v[2] = _mesh.normals[3 * i + 2];
+				v += 3;
+			}
+
+			if( _mesh.hasTangents )
+			{
+				v[0] = _mesh.tangents[4 * i + 0];
+				v[1] = _mesh.tangents[4 * i + 1];
+				v[2] = _mesh.tangents[4 * i + 2];
+				v[3] = _mesh.tangents[4 * i + 3];
+			}
+		}
+
+		releaseArray( _mesh.positions );
+		releaseArray( _mesh.texcoords );
+		releaseArray( _mesh.normals );
+		releaseArray( _mesh.tangents );
+	}
+
+	// Filename resolves material libraries, empty for streams
+	template<typename Input>
+	void loadMesh( meshloader& loader, Input& input, const std::string& filename, indexedmesh& mesh )
+	{
+		mesh.clear();
+
+		// Parser memory stays on the heap, its chunks are rewound while the builder allocates
+		arenascope scope( loader.memory );
+
+		objparserf parser;
+		parser.numThreads = loader.numThreads;
+		parser.triangulate = true;
+
+		// Faces out of range are reported on their line and never reach the builder
+		parser.checkIndices = true;
+
+		meshbuilder builder( loader, mesh, filename );
+		builder.connect( parser );
+
+		parser.parse( input );
+		builder.finish( loader.interleaved );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// indexedmesh
+//////////////////////////////////////////////////////////////////////////
+indexedmesh::indexedmesh( arena* memory )
+	: vertices( memory ), positions( memory ), texcoords( memory ), normals( memory ), tangents( memory ), indices( memory )
+{
+	clear();
+}
+
+void indexedmesh::clear()
+{
+	numVertices = 0;
+	hasTexCoords = false;
+	hasNormals = false;
+	hasTangents = false;
+	vertexStride = 0;
+
+	clearArray( vertices );
+	clearArray( positions );
+	clearArray( texcoords );
+	clearArray( normals );
+	clearArray( tangents );
+	clearArray( indices );
+	parts.clear();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// meshloader
+//////////////////////////////////////////////////////////////////////////
+meshloader::meshloader()
+{
+	interleaved = false;
+	numThreads = 1;
+	materials = 0;
+	memory = 0;
+	generateNormals = false;
+	angleWeightedNormals = false;
+	generateTangents = false;
+	optimize = false;
+}
+
+void meshloader::load( const char* filename, indexedmesh& mesh )
+{
+	loadMesh( *this, filename, filename, mesh );
+}
+
+void meshloader::load( std::istream& file, indexedmesh& mesh )
+{
+	loadMesh( *this, file, std::string(), mesh );
+}
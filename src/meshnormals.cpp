@@ -0,0 +1,506 @@
+#include <obj/meshnormals.h>
+#include <obj/meshloader.h>
+#include "thread.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace obj;
+
+// Triangles or vertices per block, blocks are added in the same order whatever the number of threads
+static const size_t BLOCK_SIZE = 64 << 10;
+
+namespace
+{
+	inline void subtract( const float* a, const float* b, float* r )
+	{
+		r[0] = a[0] - b[0];
+		r[1] = a[1] - b[1];
+		r[2] = a[2] - b[2];
+	}
+
+	inline void cross( const float* a, const float* b, float* r )
+	{
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline float dot( const float* a, const float* b )
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	inline float length( const float* a )
+	{
+		return std::sqrt( dot( a, a ) );
+	}
+
+	// Scale to unit length, false if zero
+	inline bool normalize( float* a )
+	{
+		const float len = length( a );
+		if( len == 0.0f )
+			return false;
+
+		a[0] /= len;
+		a[1] /= len;
+		a[2] /= len;
+		return true;
+	}
+
+	// Remove component along unit vector n
+	inline void reject( float* a, const float* n )
+	{
+		const float d = dot( a, n );
+		a[0] -= d * n[0];
+		a[1] -= d * n[1];
+		a[2] -= d * n[2];
+	}
+
+	// Angle between a and b given the length of their cross product
+	inline float angle( const float* a, const float* b, float crossLength )
+	{
+		return std::atan2( crossLength, dot( a, b ) );
+	}
+
+	// Interior angle of triangle at each corner
+	void cornerAngles( const float* const* p, float crossLength, float* angles )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			float a[3];
+			float b[3];
+			subtract( p[( k + 1 ) % 3], p[k], a );
+			subtract( p[( k + 2 ) % 3], p[k], b );
+			angles[k] = angle( a, b, crossLength );
+		}
+	}
+
+	/************************************************************************/
+	/* Block loop                                                           */
+	/************************************************************************/
+
+	typedef void (*blockfunction)( void* arg, size_t block );
+
+	struct blockloop
+	{
+		blockfunction f;
+		void* arg;
+		size_t numBlocks;
+		size_t nextBlock;
+
+		mutex guard;
+	};
+
+	void runBlocks( void* arg )
+	{
+		blockloop& loop = *(blockloop*)arg;
+
+		while( true )
+		{
+			size_t block;
+			{
+				scoped_lock lock( loop.guard );
+
+				if( loop.nextBlock == loop.numBlocks )
+					return;
+
+				block = loop.nextBlock++;
+			}
+
+			loop.f( loop.arg, block );
+		}
+	}
+
+	// Call f for every block, on the calling thread and up to numThreads - 1 others
+	void forEachBlock( unsigned int numThreads, size_t numBlocks, blockfunction f, void* arg )
+	{
+		blockloop loop;
+		loop.f = f;
+		loop.arg = arg;
+		loop.numBlocks = numBlocks;
+		loop.nextBlock = 0;
+
+		const unsigned int workers = ( numThreads == 0 ) ? thread::hardwareConcurrency() : numThreads;
+
+		std::vector<thread*> threads;
+		for( size_t i = 1; i < workers && i < numBlocks; ++i )
+		{
+			thread* t = new thread();
+			if( t->start( runBlocks, &loop ) )
+				threads.push_back( t );
+			else
+				delete t;
+		}
+
+		runBlocks( &loop );
+
+		for( size_t i = 0; i < threads.size(); ++i )
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+	}
+
+	/************************************************************************/
+	/* Triangle to vertex sums                                              */
+	/* Faces::SIZE values per corner, from Faces::corners( triangle, out )  */
+	/************************************************************************/
+
+	template<typename Faces>
+	struct scatter
+	{
+		struct spill
+		{
+			unsigned int vertex;
+			float values[Faces::SIZE];
+		};
+
+		const Faces* faces;
+		const unsigned int* indices;
+		size_t numTriangles;
+
+		// Faces::SIZE per vertex
+		float* sums;
+
+		// Block b adds straight into vertices [firstOwned[b], firstOwned[b + 1]), earlier ones are spilled
+		std::vector<unsigned int> firstOwned;
+		std::vector< std::vector<spill> > spills;
+	};
+
+	template<typename Faces>
+	void findOwned( void* arg, size_t block )
+	{
+		scatter<Faces>& s = *(scatter<Faces>*)arg;
+
+		const size_t begin = 3 * block * BLOCK_SIZE;
+		const size_t end = 3 * std::min( ( block + 1 ) * BLOCK_SIZE, s.numTriangles );
+
+		// Vertices past the last one used by the block, made cumulative afterwards
+		unsigned int last = 0;
+		for( size_t i = begin; i < end; ++i )
+			last = std::max( last, s.indices[i] + 1 );
+
+		s.firstOwned[block + 1] = last;
+	}
+
+	template<typename Faces>
+	void addBlock( void* arg, size_t block )
+	{
+		scatter<Faces>& s = *(scatter<Faces>*)arg;
+
+		const size_t begin = block * BLOCK_SIZE;
+		const size_t end = std::min( begin + BLOCK_SIZE, s.numTriangles );
+		const unsigned int owned = s.firstOwned[block];
+
+		std::vector<typename scatter<Faces>::spill>& spills = s.spills[block];
+		float corners[3][Faces::SIZE];
+
+		for( size_t i = begin; i < end; ++i )
+		{
+			const unsigned int* triangle = s.indices + 3 * i;
+			s.faces->corners( triangle, corners );
+
+			for( int k = 0; k < 3; ++k )
+			{
+				if( triangle[k] >= owned )
+				{
+					float* sum = s.sums + (size_t)Faces::SIZE * triangle[k];
+					for( int j = 0; j < Faces::SIZE; ++j )
+						sum[j] += corners[k][j];
+				}
+				else
+				{
+					typename scatter<Faces>::spill sp;
+					sp.vertex = triangle[k];
+					for( int j = 0; j < Faces::SIZE; ++j )
+						sp.values[j] = corners[k][j];
+					spills.push_back( sp );
+				}
+			}
+		}
+	}
+
+	// Faces::SIZE sums per vertex of the corners of all triangles
+	template<typename Faces>
+	void sumCorners( const Faces& faces, const indexedmesh& mesh, unsigned int numThreads, std::vector<float>& sums )
+	{
+		sums.assign( (size_t)Faces::SIZE * mesh.numVertices, 0.0f );
+
+		scatter<Faces> s;
+		s.faces = &faces;
+		s.indices = mesh.indices.empty() ? 0 : &mesh.indices[0];
+		s.numTriangles = mesh.indices.size() / 3;
+		s.sums = sums.empty() ? 0 : &sums[0];
+
+		const size_t numBlocks = ( s.numTriangles + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+		s.firstOwned.assign( numBlocks + 1, 0 );
+		s.spills.resize( numBlocks );
+
+		forEachBlock( numThreads, numBlocks, findOwned<Faces>, &s );
+
+		for( size_t b = 1; b <= numBlocks; ++b )
+			s.firstOwned[b] = std::max( s.firstOwned[b], s.firstOwned[b - 1] );
+
+		forEachBlock( numThreads, numBlocks, addBlock<Faces>, &s );
+
+		// In block order, as a single thread would
+		for( size_t b = 0; b < numBlocks; ++b )
+		{
+			const std::vector<typename scatter<Faces>::spill>& spills = s.spills[b];
+
+			for( size_t i = 0; i < spills.size(); ++i )
+			{
+				float* sum = s.sums + (size_t)Faces::SIZE * spills[i].vertex;
+				for( int j = 0; j < Faces::SIZE; ++j )
+					sum[j] += spills[i].values[j];
+			}
+		}
+	}
+
+	/************************************************************************/
+	/* Normals                                                              */
+	/************************************************************************/
+
+	class normalfaces
+	{
+	public:
+		enum { SIZE = 3 };
+
+		const float* positions;
+		bool angleWeighted;
+
+		void corners( const unsigned int* triangle, float (*values)[SIZE] ) const
+		{
+			const float* p[3] = { positions + 3 * triangle[0], positions + 3 * triangle[1], positions + 3 * triangle[2] };
+
+			// Twice the area long
+			float e1[3];
+			float e2[3];
+			float n[3];
+			subtract( p[1], p[0], e1 );
+			subtract( p[2], p[0], e2 );
+			cross( e1, e2, n );
+
+			float weights[3] = { 1.0f, 1.0f, 1.0f };
+
+			if( angleWeighted )
+			{
+				const float len = length( n );
+				if( len > 0.0f )
+				{
+					cornerAngles( p, len, weights );
+					for( int k = 0; k < 3; ++k )
+						weights[k] /= len;
+				}
+			}
+
+			for( int k = 0; k < 3; ++k )
+			{
+				values[k][0] = n[0] * weights[k];
+				values[k][1] = n[1] * weights[k];
+				values[k][2] = n[2] * weights[k];
+			}
+		}
+	};
+
+	struct normalresult
+	{
+		const float* sums;
+		const unsigned char* generated;
+		float* normals;
+		unsigned int numVertices;
+	};
+
+	void writeNormals( void* arg, size_t block )
+	{
+		normalresult& r = *(normalresult*)arg;
+
+		const size_t end = std::min( ( block + 1 ) * BLOCK_SIZE, (size_t)r.numVertices );
+
+		for( size_t i = block * BLOCK_SIZE; i < end; ++i )
+		{
+			if( r.generated && !r.generated[i] )
+				continue;
+
+			float* n = r.normals + 3 * i;
+			const float* sum = r.sums + 3 * i;
+			n[0] = sum[0];
+			n[1] = sum[1];
+			n[2] = sum[2];
+
+			// Vertices of degenerate triangles only are left zero
+			normalize( n );
+		}
+	}
+
+	/************************************************************************/
+	/* Tangents                                                             */
+	/************************************************************************/
+
+	// Sums of tangents (u direction) and bitangents (v direction), angle weighted, made orthogonal to the vertex normal once summed
+	class tangentfaces
+	{
+	public:
+		enum { SIZE = 6 };
+
+		const float* positions;
+		const float* texcoords;
+
+		void corners( const unsigned int* triangle, float (*values)[SIZE] ) const
+		{
+			const float* p[3] = { positions + 3 * triangle[0], positions + 3 * triangle[1], positions + 3 * triangle[2] };
+			const float* t[3] = { texcoords + 2 * triangle[0], texcoords + 2 * triangle[1], texcoords + 2 * triangle[2] };
+
+			float e1[3];
+			float e2[3];
+			float n[3];
+			subtract( p[1], p[0], e1 );
+			subtract( p[2], p[0], e2 );
+			cross( e1, e2, n );
+
+			const float du1 = t[1][0] - t[0][0];
+			const float dv1 = t[1][1] - t[0][1];
+			const float du2 = t[2][0] - t[0][0];
+			const float dv2 = t[2][1] - t[0][1];
+
+			// Texture space orientation, lengths do not matter
+			const float r = du1 * dv2 - du2 * dv1;
+			const float len = length( n );
+
+			if( r == 0.0f || len == 0.0f )
+			{
+				for( int k = 0; k < 3; ++k )
+					for( int j = 0; j < SIZE; ++j )
+						values[k][j] = 0.0f;
+				return;
+			}
+
+			const float s = ( r > 0.0f ) ? 1.0f : -1.0f;
+
+			float u[3];
+			float v[3];
+			for( int j = 0; j < 3; ++j )
+			{
+				u[j] = s * ( e1[j] * dv2 - e2[j] * dv1 );
+				v[j] = s * ( e2[j] * du1 - e1[j] * du2 );
+			}
+
+			// Directions only, so triangles count by angle and not by texture scale
+			normalize( u );
+			normalize( v );
+
+			float angles[3];
+			cornerAngles( p, len, angles );
+
+			for( int k = 0; k < 3; ++k )
+			{
+				for( int j = 0; j < 3; ++j )
+				{
+					values[k][j] = u[j] * angles[k];
+					values[k][j + 3] = v[j] * angles[k];
+				}
+			}
+		}
+	};
+
+	struct tangentresult
+	{
+		const float* sums;
+		const float* normals;
+		float* tangents;
+		unsigned int numVertices;
+	};
+
+	void writeTangents( void* arg, size_t block )
+	{
+		tangentresult& r = *(tangentresult*)arg;
+
+		const size_t end = std::min( ( block + 1 ) * BLOCK_SIZE, (size_t)r.numVertices );
+
+		for( size_t i = block * BLOCK_SIZE; i < end; ++i )
+		{
+			const float* n = r.normals + 3 * i;
+			const float* sum = r.sums + 6 * i;
+			float* t = r.tangents + 4 * i;
+
+			t[0] = sum[0];
+			t[1] = sum[1];
+			t[2] = sum[2];
+			reject( t, n );
+
+			// No texture mapping around vertex, any direction in the plane of its normal
+			if( !normalize( t ) )
+			{
+				float axis[3] = { 0.0f, 0.0f, 0.0f };
+				axis[( std::fabs( n[0] ) < 0.5f ) ? 0 : 1] = 1.0f;
+
+				cross( n, axis, t );
+				if( !normalize( t ) )
+					t[0] = 1.0f;
+			}
+
+			float b[3];
+			cross( n, t, b );
+			t[3] = ( dot( b, sum + 3 ) < 0.0f ) ? -1.0f : 1.0f;
+		}
+	}
+}
+
+meshnormals::meshnormals()
+{
+	angleWeighted = false;
+	numThreads = 1;
+}
+
+void meshnormals::computeNormals( indexedmesh& mesh, const unsigned char* generated ) const
+{
+	mesh.normals.resize( 3 * (size_t)mesh.numVertices, 0.0f );
+	mesh.hasNormals = true;
+
+	if( mesh.numVertices == 0 )
+		return;
+
+	normalfaces faces;
+	faces.positions = &mesh.positions[0];
+	faces.angleWeighted = angleWeighted;
+
+	std::vector<float> sums;
+	sumCorners( faces, mesh, numThreads, sums );
+
+	normalresult r;
+	r.sums = &sums[0];
+	r.generated = generated;
+	r.normals = &mesh.normals[0];
+	r.numVertices = mesh.numVertices;
+
+	forEachBlock( numThreads, ( mesh.numVertices + BLOCK_SIZE - 1 ) / BLOCK_SIZE, writeNormals, &r );
+}
+
+void meshnormals::computeTangents( indexedmesh& mesh ) const
+{
+	if( !mesh.hasTexCoords || !mesh.hasNormals )
+		return;
+
+	mesh.tangents.resize( 4 * (size_t)mesh.numVertices );
+	mesh.hasTangents = true;
+
+	if( mesh.numVertices == 0 )
+		return;
+
+	tangentfaces faces;
+	faces.positions = &mesh.positions[0];
+	faces.texcoords = &mesh.texcoords[0];
+
+	std::vector<float> sums;
+	sumCorners( faces, mesh, numThreads, sums );
+
+	tangentresult r;
+	r.sums = &sums[0];
+	r.normals = &mesh.normals[0];
+	r.tangents = &mesh.tangents[0];
+	r.numVertices = mesh.numVertices;
+
+	forEachBlock( numThreads, ( mesh.numVertices + BLOCK_SIZE - 1 ) / BLOCK_SIZE, writeTangents, &r );
+}
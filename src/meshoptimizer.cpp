@@ -0,0 +1,249 @@
+#include <obj/meshoptimizer.h>
+#include <obj/meshloader.h>
+#include <vector>
+
+using namespace obj;
+
+namespace
+{
+	const unsigned int NONE = ~0u;
+
+	// Triangles using each vertex
+	class adjacency
+	{
+	public:
+		adjacency( const indexedmesh::indexarray& indices, unsigned int numVertices )
+			: _offsets( numVertices + 1, 0 ), _triangles( indices.size() )
+		{
+			for( size_t i = 0; i < indices.size(); ++i )
+				++_offsets[indices[i] + 1];
+
+			for( unsigned int v = 0; v < numVertices; ++v )
+				_offsets[v + 1] += _offsets[v];
+
+			// Fill from each vertex's start, then shift starts back
+			for( size_t i = 0; i < indices.size(); ++i )
+				_triangles[_offsets[indices[i]]++] = (unsigned int)( i / 3 );
+
+			for( unsigned int v = numVertices; v > 0; --v )
+				_offsets[v] = _offsets[v - 1];
+			_offsets[0] = 0;
+		}
+
+		const unsigned int* begin( unsigned int v ) const { return &_triangles[0] + _offsets[v]; }
+		const unsigned int* end( unsigned int v ) const { return &_triangles[0] + _offsets[v + 1]; }
+
+	private:
+		std::vector<unsigned int> _offsets;
+		std::vector<unsigned int> _triangles;
+	};
+
+	// Tipsify state shared by all parts
+	class tipsify
+	{
+	public:
+		tipsify( const indexedmesh::indexarray& indices, unsigned int numVertices, unsigned int cacheSize )
+			: _indices( indices ), _adjacency( indices, numVertices ), _cacheSize( cacheSize ),
+			  _live( numVertices, 0 ), _cacheTime( numVertices, 0 ), _emitted( indices.size() / 3, false ),
+			  _time( cacheSize + 1 )
+		{
+			// empty
+		}
+
+		// Reordered triangles [first, first + count) appended to output
+		void reorder( unsigned int first, unsigned int count, std::vector<unsigned int>& output );
+
+	private:
+		unsigned int nextVertex();
+		unsigned int skipDeadEnd();
+
+		const indexedmesh::indexarray& _indices;
+		adjacency _adjacency;
+		unsigned int _cacheSize;
+
+		// Triangles of current part not emitted yet using each vertex
+		std::vector<unsigned int> _live;
+
+		// Time each vertex last entered the cache
+		std::vector<unsigned int> _cacheTime;
+		std::vector<bool> _emitted;
+		unsigned int _time;
+
+		// Current part
+		unsigned int _first;
+		unsigned int _end;
+
+		// Vertices of last fan, and recent vertices that may still have triangles
+		std::vector<unsigned int> _candidates;
+		std::vector<unsigned int> _deadEnds;
+
+		// Position in current part's indices of next vertex tried when all else is done
+		size_t _cursor;
+	};
+
+	void tipsify::reorder( unsigned int first, unsigned int count, std::vector<unsigned int>& output )
+	{
+		if( count == 0 )
+			return;
+
+		_first = first;
+		_end = first + count;
+		_cursor = 3 * (size_t)first;
+		_deadEnds.clear();
+
+		for( size_t i = 3 * (size_t)_first; i < 3 * (size_t)_end; ++i )
+			++_live[_indices[i]];
+
+		unsigned int fan = _indices[3 * (size_t)_first];
+
+		while( fan != NONE )
+		{
+			_candidates.clear();
+
+			for( const unsigned int* t = _adjacency.begin( fan ); t != _adjacency.end( fan ); ++t )
+			{
+				// Triangles of other parts are left to their part
+				if( *t < _first || *t >= _end || _emitted[*t] )
+					continue;
+
+				_emitted[*t] = true;
+
+				for( int k = 0; k < 3; ++k )
+				{
+					const unsigned int v = _indices[3 * (size_t)*t + k];
+
+					output.push_back( v );
+					_deadEnds.push_back( v );
+					_candidates.push_back( v );
+					--_live[v];
+
+					if( _time - _cacheTime[v] > _cacheSize )
+						_cacheTime[v] = _time++;
+				}
+			}
+
+			fan = nextVertex();
+		}
+	}
+
+	unsigned int tipsify::nextVertex()
+	{
+		unsigned int best = NONE;
+		int bestPriority = -1;
+
+		// Candidate that will still be in cache after its remaining triangles, oldest first
+		for( size_t i = 0; i < _candidates.size(); ++i )
+		{
+			const unsigned int v = _candidates[i];
+			if( _live[v] == 0 )
+				continue;
+
+			int priority = 0;
+			if( _time - _cacheTime[v] + 2 * _live[v] <= _cacheSize )
+				priority = (int)( _time - _cacheTime[v] );
+
+			if( priority > bestPriority )
+			{
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		return ( best != NONE ) ? best : skipDeadEnd();
+	}
+
+	unsigned int tipsify::skipDeadEnd()
+	{
+		while( !_deadEnds.empty() )
+		{
+			const unsigned int v = _deadEnds.back();
+			_deadEnds.pop_back();
+
+			if( _live[v] > 0 )
+				return v;
+		}
+
+		for( ; _cursor < 3 * (size_t)_end; ++_cursor )
+		{
+			const unsigned int v = _indices[_cursor];
+			if( _live[v] > 0 )
+				return v;
+		}
+
+		return NONE;
+	}
+
+	// Move n values per vertex to their new place
+	void remap( indexedmesh::floatarray& a, const std::vector<unsigned int>& newIndex, unsigned int n )
+	{
+		if( a.empty() )
+			return;
+
+		indexedmesh::floatarray moved( a.size(), 0.0f, a.get_allocator() );
+
+		for( size_t v = 0; v < newIndex.size(); ++v )
+		{
+			const float* from = &a[n * v];
+			float* to = &moved[n * (size_t)newIndex[v]];
+
+			for( unsigned int k = 0; k < n; ++k )
+				to[k] = from[k];
+		}
+
+		moved.swap( a );
+	}
+}
+
+meshoptimizer::meshoptimizer()
+{
+	cacheSize = 16;
+}
+
+void meshoptimizer::optimize( indexedmesh& mesh ) const
+{
+	if( mesh.indices.empty() )
+		return;
+
+	// Each part is reordered on its own, as are the runs of triangles before, between and after parts,
+	// so no triangle leaves its range
+	std::vector<unsigned int> order;
+	order.reserve( mesh.indices.size() );
+	{
+		tipsify t( mesh.indices, mesh.numVertices, cacheSize );
+		unsigned int next = 0;
+
+		for( size_t i = 0; i < mesh.parts.size(); ++i )
+		{
+			const indexedmesh::part& p = mesh.parts[i];
+
+			t.reorder( next, ( p.firstIndex - 3 * next ) / 3, order );
+			t.reorder( p.firstIndex / 3, p.numIndices / 3, order );
+			next = ( p.firstIndex + p.numIndices ) / 3;
+		}
+
+		t.reorder( next, (unsigned int)( mesh.indices.size() / 3 ) - next, order );
+	}
+
+	// Vertices in order of first use
+	std::vector<unsigned int> newIndex( mesh.numVertices, NONE );
+	unsigned int numUsed = 0;
+
+	for( size_t i = 0; i < order.size(); ++i )
+	{
+		unsigned int& v = newIndex[order[i]];
+		if( v == NONE )
+			v = numUsed++;
+
+		mesh.indices[i] = v;
+	}
+
+	for( size_t v = 0; v < newIndex.size(); ++v )
+		if( newIndex[v] == NONE )
+			newIndex[v] = numUsed++;
+
+	remap( mesh.vertices, newIndex, mesh.vertexStride );
+	remap( mesh.positions, newIndex, 3 );
+	remap( mesh.texcoords, newIndex, 2 );
+	remap( mesh.normals, newIndex, 3 );
+	remap( mesh.tangents, newIndex, 4 );
+}
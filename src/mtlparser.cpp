@@ -1,253 +1,764 @@
 #include <obj/mtlparser.h>
+#include "scanner.h"
+#include "mappedfile.h"
+#include "timer.h"
+#include "decompressor.h"
 #include <fstream>
-#include <sstream>
+#include <cstring>
 
 using namespace obj;
 
+namespace
+{
+	// Number of a texture map option, ends at whitespace so filenames starting with digits are not taken
+	template<typename Number>
+	bool readOptionValue( const char*& p, const char* end, Number& value )
+	{
+		const char* s = p;
+		if( !scanner::parseReal( s, end, value ) || ( s != end && !scanner::isSpace( *s ) ) )
+			return false;
+
+		p = scanner::skipSpace( s, end );
+		return true;
+	}
+
+	bool readOptionValue( const char*& p, const char* end, int& value )
+	{
+		const char* s = p;
+		if( !scanner::parseInt( s, end, value ) || ( s != end && !scanner::isSpace( *s ) ) )
+			return false;
+
+		p = scanner::skipSpace( s, end );
+		return true;
+	}
+
+	// u [v [w]], missing values keep their defaults
+	bool readOptionVector( const char*& p, const char* end, vec3f& v )
+	{
+		if( !readOptionValue( p, end, v.x ) )
+			return false;
+
+		if( readOptionValue( p, end, v.y ) )
+			readOptionValue( p, end, v.z );
+
+		return true;
+	}
+
+	// Index of next word in names, which is added to first
+	bool readOptionWord( const char*& p, const char* end, const char* const* names, unsigned int numNames,
+						 unsigned int first, unsigned int& value )
+	{
+		const char* word = p;
+		const char* wordEnd = scanner::skipToken( p, end );
+
+		for( unsigned int i = 0; i < numNames; ++i )
+		{
+			if( scanner::equals( word, wordEnd, names[i] ) )
+			{
+				value = first + i;
+				p = scanner::skipSpace( wordEnd, end );
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool readOptionSwitch( const char*& p, const char* end, unsigned int flag, unsigned int& flags )
+	{
+		static const char* const names[] = { "off", "on" };
+
+		unsigned int on;
+		if( !readOptionWord( p, end, names, 2, 0, on ) )
+			return false;
+
+		flags = on ? ( flags | flag ) : ( flags & ~flag );
+		return true;
+	}
+}
+
+mtlparser::mtlparser()
+{
+	stats = 0;
+	table = 0;
+	_lineNumber = 0;
+	_startTime = 0.0;
+}
+
 void mtlparser::parse( const char* filename )
 {
+	reset();
+
+	// Parse directly from mapped pages when possible
+	mappedfile mapping;
+	const double start = stats ? now() : 0.0;
+
+	if( mapping.open( filename ) )
+	{
+		if( stats )
+			stats->ioTime += now() - start;
+
+		if( !parseCompressed( mapping.data(), mapping.size() ) )
+			parseData( mapping.data(), mapping.data() + mapping.size() );
+
+		finish();
+		return;
+	}
+
 	std::ifstream file( filename );
 	if( !file )
 	{
+		if( stats )
+			++stats->numErrors[parsestats::FILE_ERROR];
+
 		errorSignal.send( 0, "Cannot open file '" + std::string( filename ) + "'." );
+		finish();
 		return;
 	}
 
-	parse( file );
+	parseStream( file );
+	finish();
 }
 
 void mtlparser::parse( std::istream& file )
 {
-	std::string line;
-	unsigned int lineNumber = 0;
+	reset();
+	parseStream( file );
+	finish();
+}
+
+void mtlparser::parse( const char* data, size_t size )
+{
+	reset();
+	parseData( data, data + size );
+	finish();
+}
 
-	while( std::getline( file, line ) )
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+void mtlparser::reset()
+{
+	_lineNumber = 0;
+
+	if( table )
+		table->clear();
+
+	if( stats )
 	{
-		std::stringstream ss( line );
-		++lineNumber;
+		stats->clear();
+		_startTime = now();
+	}
+}
 
-		// Read until next whitespace
-		ss.unsetf( std::ios_base::skipws );
-		ss >> std::ws;
+void mtlparser::finish()
+{
+	if( table )
+		table->pack();
 
-		// Check empty line
-		if( ss.eof() )
-			continue;
+	if( stats )
+	{
+		// Materials are small, the time not spent reading is all attributed to tokenizing
+		stats->totalTime = now() - _startTime;
+		stats->tokenizeTime = stats->totalTime - stats->ioTime;
+	}
+}
 
-		// Check comment line
-		if( ss.peek() == '#' )
-		{
-			commentSignal.send( lineNumber, line.c_str() + 2 );
-			continue;
-		}
+void mtlparser::parseStream( std::istream& file )
+{
+	if( stats )
+		scanner::readStream( file, *this, &mtlparser::parseLines<true>, scanner::STREAM_BLOCK_SIZE, &stats->ioTime );
+	else
+		scanner::readStream( file, *this, &mtlparser::parseLines<false> );
+}
 
-		// Check keyword
-		std::string keyword;
-		ss >> keyword;
-		
-		// Case new material
-		if( keyword == "newmtl" )
-		{
-			std::string name;
-			ss >> std::ws >> name >> std::ws;
+void mtlparser::parseData( const char* begin, const char* end )
+{
+	if( stats )
+		parseLines<true>( begin, end );
+	else
+		parseLines<false>( begin, end );
+}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading material name, skipping it." );
-				continue;
-			}
+bool mtlparser::parseCompressed( const char* data, size_t size )
+{
+	const decompressor::format format = decompressor::detect( data, size );
+	if( format == decompressor::NONE )
+		return false;
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond first material name." );
+	if( !decompressor::isSupported( format ) )
+	{
+		if( stats )
+			++stats->numErrors[parsestats::UNSUPPORTED_ERROR];
 
-			beginMaterialSignal.send( name );
-		}
-		// Case ambient
-		else if( keyword == "Ka" )
-		{
-			vec3d a;
-			ss >> std::ws;
+		errorSignal.send( 0, std::string( "Cannot read " ) + decompressor::name( format ) + " compressed file, support not built in." );
+		return true;
+	}
 
-			// Check option
-			if( !isdigit( ss.peek() ) )
-			{
-				errorSignal.send( lineNumber, "Ambient color not RGB, skipping it." );
-				continue;
-			}
+	decompressor input( data, size, format, scanner::STREAM_BLOCK_SIZE );
 
-			ss >> a.x >> std::ws >> a.y >> std::ws >> a.z >> std::ws;
+	bool ok;
+	if( stats )
+		ok = input.readLines( *this, &mtlparser::parseLines<true>, &stats->ioTime );
+	else
+		ok = input.readLines( *this, &mtlparser::parseLines<false> );
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading ambient color, skipping it." );
-				continue;
-			}
+	if( !ok )
+	{
+		if( stats )
+			++stats->numErrors[parsestats::FILE_ERROR];
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond third ambient color value." );
+		errorSignal.send( _lineNumber, "Error decompressing file: " + input.error() + "." );
+	}
 
-			ambientSignal.send( a );
-		}
-		// Case diffuse
-		else if( keyword == "Kd" )
-		{
-			vec3d d;
-			ss >> std::ws;
+	return true;
+}
 
-			// Check option
-			if( !isdigit( ss.peek() ) )
-			{
-				errorSignal.send( lineNumber, "Diffuse color not RGB, skipping it." );
-				continue;
-			}
+template<bool Profile>
+void mtlparser::parseLines( const char* begin, const char* end )
+{
+	if( Profile )
+		stats->numBytes += end - begin;
 
-			ss >> std::ws >> d.x >> std::ws >> d.y >> std::ws >> d.z >> std::ws;
+	scanner::linesplitter lines( begin, end );
+	const char* line;
+	const char* lineEnd;
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading diffuse color, skipping it." );
-				continue;
-			}
+	while( lines.next( line, lineEnd ) )
+	{
+		++_lineNumber;
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond third diffuse color value." );
+		if( Profile )
+			++stats->numLines;
 
-			diffuseSignal.send( d );
-		}
-		// Case specular
-		else if( keyword == "Ks" )
-		{
-			vec3d s;
-			ss >> std::ws;
+		parseLine<Profile>( line, scanner::trimLineBreak( line, lineEnd, end ) );
+	}
+}
 
-			// Check option
-			if( !isdigit( ss.peek() ) )
-			{
-				errorSignal.send( lineNumber, "Specular color not RGB, skipping it." );
-				continue;
-			}
+template<bool Profile>
+void mtlparser::count( mtlstats::keyword keyword )
+{
+	if( Profile )
+		++stats->numKeywordLines[keyword];
+}
 
-			ss >> std::ws >> s.x >> std::ws >> s.y >> std::ws >> s.z >> std::ws;
+template<bool Profile>
+void mtlparser::error( parsestats::errortype type, const char* message, const char* arg, const char* argEnd, const char* suffix )
+{
+	_buffer.assign( message );
+	if( arg )
+	{
+		_buffer.append( arg, argEnd );
+		_buffer.append( suffix );
+	}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading specular color, skipping it." );
-				continue;
-			}
+	sendError<Profile>( type );
+}
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond third specular color value." );
+template<bool Profile>
+void mtlparser::sendError( parsestats::errortype type )
+{
+	if( Profile )
+		++stats->numErrors[type];
 
-			specularSignal.send( s );
-		}
-		// Case dissolve factor (opacity)
-		else if( keyword == "d" || keyword == "Tr" )
-		{
-			ss >> std::ws;
+	errorSignal.send( _lineNumber, _buffer );
+}
 
-			// If any options, skip field
-			if( ss.peek() == '-' )
-			{
-				errorSignal.send( lineNumber, "Opacity with options it not supported, skipping it." );
-				return;
-			}
 
-			double e;
-			ss >> std::ws >> e >> std::ws;
+template<bool Profile>
+void mtlparser::parseLine( const char* line, const char* end )
+{
+	// Read until next whitespace
+	const char* p = scanner::skipSpace( line, end );
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading opacity, skipping it." );
-				continue;
-			}
+	// Check empty line
+	if( p == end )
+	{
+		count<Profile>( mtlstats::EMPTY );
+		return;
+	}
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond opacity value." );
+	// Check comment line
+	if( *p == '#' )
+	{
+		count<Profile>( mtlstats::COMMENT );
+		_buffer.assign( scanner::lineTextBegin( line, end ), end );
+		commentSignal.send( _lineNumber, _buffer );
+		return;
+	}
 
-			opacitySignal.send( e );
-		}
-		// Case specular exponent
-		else if( keyword == "Ns" )
+	// Check keyword
+	const char* keyword = p;
+	const char* keywordEnd = scanner::skipToken( p, end );
+	p = scanner::skipSpace( keywordEnd, end );
+
+	// Case new material
+	if( scanner::equals( keyword, keywordEnd, "newmtl" ) )
+	{
+		count<Profile>( mtlstats::NEW_MATERIAL );
+
+		const char* name = p;
+		p = scanner::skipToken( name, end );
+
+		if( name == end )
 		{
-			double e;
-			ss >> std::ws >> e >> std::ws;
+			error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading material name, skipping it." );
+			return;
+		}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading specular exponent, skipping it." );
-				continue;
-			}
+		const char* nameEnd = p;
+		p = scanner::skipSpace( p, end );
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond specular exponent value." );
+		if( p != end )
+			error<Profile>( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond first material name." );
 
-			specularExpSignal.send( e );
+		if( table )
+			table->beginMaterial( name, nameEnd );
+		else
+		{
+			_buffer.assign( name, nameEnd );
+			beginMaterialSignal.send( _buffer );
 		}
-		// Case refraction index
-		else if( keyword == "Ni" )
+	}
+	// Case ambient
+	else if( scanner::equals( keyword, keywordEnd, "Ka" ) )
+	{
+		count<Profile>( mtlstats::AMBIENT );
+		parseColor<Profile>( p, end, "ambient", materialrecord::AMBIENT, &materialrecord::ambient, &ambientSignal );
+	}
+	// Case diffuse
+	else if( scanner::equals( keyword, keywordEnd, "Kd" ) )
+	{
+		count<Profile>( mtlstats::DIFFUSE );
+		parseColor<Profile>( p, end, "diffuse", materialrecord::DIFFUSE, &materialrecord::diffuse, &diffuseSignal );
+	}
+	// Case specular
+	else if( scanner::equals( keyword, keywordEnd, "Ks" ) )
+	{
+		count<Profile>( mtlstats::SPECULAR );
+		parseColor<Profile>( p, end, "specular", materialrecord::SPECULAR, &materialrecord::specular, &specularSignal );
+	}
+	// Case emissive
+	else if( scanner::equals( keyword, keywordEnd, "Ke" ) )
+	{
+		count<Profile>( mtlstats::EMISSIVE );
+		parseColor<Profile>( p, end, "emissive", materialrecord::EMISSIVE, &materialrecord::emissive, 0 );
+	}
+	// Case transmission filter
+	else if( scanner::equals( keyword, keywordEnd, "Tf" ) )
+	{
+		count<Profile>( mtlstats::TRANSMISSION_FILTER );
+		parseColor<Profile>( p, end, "transmission filter", materialrecord::TRANSMISSION, &materialrecord::transmission, 0 );
+	}
+	// Case dissolve factor (opacity)
+	else if( scanner::equals( keyword, keywordEnd, "d" ) )
+	{
+		count<Profile>( mtlstats::OPACITY );
+
+		unsigned int statement = materialrecord::OPACITY;
+
+		// Dissolve depending on surface orientation
+		const char* option = scanner::skipToken( p, end );
+		if( scanner::equals( p, option, "-halo" ) )
 		{
-			double i;
-			ss >> std::ws >> i >> std::ws;
+			statement |= materialrecord::HALO;
+			p = scanner::skipSpace( option, end );
+		}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( lineNumber, "Parse error reading refraction index, skipping it." );
-				continue;
-			}
+		parseScalar<Profile>( p, end, "opacity", statement, &materialrecord::opacity, &opacitySignal );
+	}
+	// Case transparency, sent as is like opacity but stored as its complement
+	else if( scanner::equals( keyword, keywordEnd, "Tr" ) )
+	{
+		count<Profile>( mtlstats::OPACITY );
+
+		if( !table )
+		{
+			parseScalar<Profile>( p, end, "opacity", materialrecord::OPACITY, &materialrecord::opacity, &opacitySignal );
+			return;
+		}
 
-			if( !ss.eof() )
-				errorSignal.send( lineNumber, "Ignoring information beyond refraction index value." );
+		float transparency;
+		materialrecord* m = table->current();
 
-			refractionIndexSignal.send( i );
+		if( readScalar<Profile>( p, end, "opacity", transparency ) && m )
+		{
+			m->opacity = 1.0f - transparency;
+			m->given |= materialrecord::OPACITY;
 		}
-		// Case ambient texture map
-		else if( keyword == "map_Ka" || keyword == "map_a")
+	}
+	// Case specular exponent
+	else if( scanner::equals( keyword, keywordEnd, "Ns" ) )
+	{
+		count<Profile>( mtlstats::SPECULAR_EXPONENT );
+		parseScalar<Profile>( p, end, "specular exponent", materialrecord::SPECULAR_EXPONENT, &materialrecord::specularExp, &specularExpSignal );
+	}
+	// Case refraction index
+	else if( scanner::equals( keyword, keywordEnd, "Ni" ) )
+	{
+		count<Profile>( mtlstats::REFRACTION_INDEX );
+		parseScalar<Profile>( p, end, "refraction index", materialrecord::REFRACTION_INDEX, &materialrecord::refractionIndex, &refractionIndexSignal );
+	}
+	// Case reflection sharpness
+	else if( scanner::equals( keyword, keywordEnd, "sharpness" ) )
+	{
+		count<Profile>( mtlstats::SHARPNESS );
+		parseScalar<Profile>( p, end, "sharpness", materialrecord::SHARPNESS, &materialrecord::sharpness, 0 );
+	}
+	// Case illumination model
+	else if( scanner::equals( keyword, keywordEnd, "illum" ) )
+	{
+		count<Profile>( mtlstats::ILLUMINATION );
+
+		int model;
+
+		if( !scanner::parseInt( p, end, model ) || model < 0 )
 		{
-			std::string filename;
-			bool ok = parseTextureMap( lineNumber, ss, filename );			
-			if( ok )
-				textureAmbientSignal.send( filename );
+			error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading illumination model, skipping it." );
+			return;
 		}
-		// Case diffuse texture map
-		else if( keyword == "map_Kd" || keyword == "map_d" || keyword == "map_D" )
+
+		if( scanner::skipSpace( p, end ) != end )
+			error<Profile>( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond illumination model value." );
+
+		if( materialrecord* m = table ? table->current() : 0 )
 		{
-			std::string filename;
-			bool ok = parseTextureMap( lineNumber, ss, filename );			
-			if( ok )
-				textureDiffuseSignal.send( filename );
+			m->illumination = (unsigned int)model;
+			m->given |= materialrecord::ILLUMINATION;
 		}
-		// Case specular texture map
-		else if( keyword == "map_Ks" || keyword == "map_s" )
+	}
+	// Case physically based roughness
+	else if( scanner::equals( keyword, keywordEnd, "Pr" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "roughness", materialrecord::ROUGHNESS, &materialrecord::roughness, 0 );
+	}
+	// Case physically based metallic
+	else if( scanner::equals( keyword, keywordEnd, "Pm" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "metallic", materialrecord::METALLIC, &materialrecord::metallic, 0 );
+	}
+	// Case physically based sheen
+	else if( scanner::equals( keyword, keywordEnd, "Ps" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "sheen", materialrecord::SHEEN, &materialrecord::sheen, 0 );
+	}
+	// Case physically based clearcoat thickness
+	else if( scanner::equals( keyword, keywordEnd, "Pc" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "clearcoat", materialrecord::CLEARCOAT, &materialrecord::clearcoat, 0 );
+	}
+	// Case physically based clearcoat roughness
+	else if( scanner::equals( keyword, keywordEnd, "Pcr" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "clearcoat roughness", materialrecord::CLEARCOAT_ROUGHNESS, &materialrecord::clearcoatRoughness, 0 );
+	}
+	// Case physically based anisotropy
+	else if( scanner::equals( keyword, keywordEnd, "aniso" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "anisotropy", materialrecord::ANISOTROPY, &materialrecord::anisotropy, 0 );
+	}
+	// Case physically based anisotropy rotation
+	else if( scanner::equals( keyword, keywordEnd, "anisor" ) )
+	{
+		count<Profile>( mtlstats::PHYSICAL );
+		parseScalar<Profile>( p, end, "anisotropy rotation", materialrecord::ANISOTROPY_ROTATION, &materialrecord::anisotropyRotation, 0 );
+	}
+	// Case ambient texture map
+	else if( scanner::equals( keyword, keywordEnd, "map_Ka" ) || scanner::equals( keyword, keywordEnd, "map_a" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::AMBIENT, &textureAmbientSignal );
+	}
+	// Case diffuse texture map
+	else if( scanner::equals( keyword, keywordEnd, "map_Kd" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::DIFFUSE, &textureDiffuseSignal );
+	}
+	// Case dissolve texture map, sent as diffuse texture
+	else if( scanner::equals( keyword, keywordEnd, "map_d" ) || scanner::equals( keyword, keywordEnd, "map_D" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::OPACITY, &textureDiffuseSignal );
+	}
+	// Case specular texture map
+	else if( scanner::equals( keyword, keywordEnd, "map_Ks" ) || scanner::equals( keyword, keywordEnd, "map_s" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::SPECULAR, &textureSpecularSignal );
+	}
+	// Case specular exponent texture map
+	else if( scanner::equals( keyword, keywordEnd, "map_Ns" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::SPECULAR_EXPONENT, 0 );
+	}
+	// Case emissive texture map
+	else if( scanner::equals( keyword, keywordEnd, "map_Ke" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::EMISSIVE, 0 );
+	}
+	// Case bump map
+	else if( scanner::equals( keyword, keywordEnd, "bump" ) || scanner::equals( keyword, keywordEnd, "map_Bump" ) ||
+			 scanner::equals( keyword, keywordEnd, "map_bump" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::BUMP, 0 );
+	}
+	// Case displacement map
+	else if( scanner::equals( keyword, keywordEnd, "disp" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::DISPLACEMENT, 0 );
+	}
+	// Case decal map
+	else if( scanner::equals( keyword, keywordEnd, "decal" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::DECAL, 0 );
+	}
+	// Case reflection map
+	else if( scanner::equals( keyword, keywordEnd, "refl" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::REFLECTION, 0 );
+	}
+	// Case physically based texture maps
+	else if( scanner::equals( keyword, keywordEnd, "map_Pr" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::ROUGHNESS, 0 );
+	}
+	else if( scanner::equals( keyword, keywordEnd, "map_Pm" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::METALLIC, 0 );
+	}
+	else if( scanner::equals( keyword, keywordEnd, "map_Ps" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::SHEEN, 0 );
+	}
+	else if( scanner::equals( keyword, keywordEnd, "norm" ) )
+	{
+		count<Profile>( mtlstats::TEXTURE_MAP );
+		parseTextureMap<Profile>( p, end, texturemap::NORMAL, 0 );
+	}
+	// Case unknown
+	else
+	{
+		count<Profile>( mtlstats::UNKNOWN );
+		error<Profile>( parsestats::UNKNOWN_KEYWORD_ERROR, "Unknown keyword '", keyword, keywordEnd, "', skipping line." );
+	}
+}
+
+template<bool Profile, typename Real>
+bool mtlparser::readColor( const char* p, const char* end, const char* name, vec3<Real>& color )
+{
+	const char* nameEnd = name + strlen( name );
+
+	// Spectral curve or CIEXYZ values
+	const char* word = scanner::skipToken( p, end );
+	if( scanner::equals( p, word, "spectral" ) || scanner::equals( p, word, "xyz" ) )
+	{
+		_buffer.assign( name, nameEnd );
+		_buffer.append( " color not RGB, skipping it." );
+		_buffer[0] = (char)( _buffer[0] - 'a' + 'A' );
+
+		sendError<Profile>( parsestats::UNSUPPORTED_ERROR );
+		return false;
+	}
+
+	if( !scanner::parseReal( p, end, color.x ) )
+	{
+		error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading ", name, nameEnd, " color, skipping it." );
+		return false;
+	}
+
+	// Green and blue are optional and default to red
+	p = scanner::skipSpace( p, end );
+	if( p == end )
+	{
+		color.y = color.x;
+		color.z = color.x;
+		return true;
+	}
+
+	bool ok = scanner::parseReal( p, end, color.y );
+	if( ok )
+	{
+		p = scanner::skipSpace( p, end );
+		ok = scanner::parseReal( p, end, color.z );
+	}
+
+	if( !ok )
+	{
+		error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading ", name, nameEnd, " color, skipping it." );
+		return false;
+	}
+
+	if( scanner::skipSpace( p, end ) != end )
+		error<Profile>( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond third ", name, nameEnd, " color value." );
+
+	return true;
+}
+
+template<bool Profile, typename Real>
+bool mtlparser::readScalar( const char* p, const char* end, const char* name, Real& value )
+{
+	const char* nameEnd = name + strlen( name );
+
+	if( !scanner::parseReal( p, end, value ) )
+	{
+		error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading ", name, nameEnd, ", skipping it." );
+		return false;
+	}
+
+	if( scanner::skipSpace( p, end ) != end )
+		error<Profile>( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond ", name, nameEnd, " value." );
+
+	return true;
+}
+
+template<bool Profile>
+void mtlparser::parseColor( const char* p, const char* end, const char* name, unsigned int statement,
+							vec3f materialrecord::* field, sig::signal1<const vec3d&>* signal )
+{
+	if( table )
+	{
+		vec3f color;
+		materialrecord* m = table->current();
+
+		if( readColor<Profile>( p, end, name, color ) && m )
 		{
-			std::string filename;
-			bool ok = parseTextureMap( lineNumber, ss, filename );			
-			if( ok )
-				textureSpecularSignal.send( filename );
+			m->*field = color;
+			m->given |= statement;
 		}
-		// Case unknown
-		else
+	}
+	else
+	{
+		vec3d color;
+
+		if( readColor<Profile>( p, end, name, color ) && signal )
+			signal->send( color );
+	}
+}
+
+template<bool Profile>
+void mtlparser::parseScalar( const char* p, const char* end, const char* name, unsigned int statement,
+							 float materialrecord::* field, sig::signal1<double>* signal )
+{
+	if( table )
+	{
+		float value;
+		materialrecord* m = table->current();
+
+		if( readScalar<Profile>( p, end, name, value ) && m )
 		{
-			errorSignal.send( lineNumber, "Unknown keyword '" + keyword + "', skipping line." );
+			m->*field = value;
+			m->given |= statement;
 		}
 	}
+	else
+	{
+		double value;
+
+		if( readScalar<Profile>( p, end, name, value ) && signal )
+			signal->send( value );
+	}
 }
 
-//////////////////////////////////////////////////////////////////////////
-// Private
-//////////////////////////////////////////////////////////////////////////
-bool mtlparser::parseTextureMap( unsigned int lineNumber, std::stringstream& ss, std::string& filename )
+template<bool Profile>
+void mtlparser::parseTextureMap( const char* p, const char* end, texturemap::maptype type,
+								 sig::signal1<const std::string&>* signal )
 {
-	ss >> std::ws;
+	texturemap map;
+	map.type = type;
 
-	if( ss.peek() == '-' )
-		errorSignal.send( lineNumber, "Skipping texture map options." );
+	// Options come before the filename
+	while( p != end && *p == '-' )
+	{
+		if( !parseMapOption<Profile>( p, end, map ) )
+			return;
+	}
+
+	// Filename is the rest of the line and may contain spaces
+	const char* filenameEnd = end;
+	while( filenameEnd != p && scanner::isSpace( filenameEnd[-1] ) )
+		--filenameEnd;
 
-	while( !ss.eof() )
-		ss >> std::ws >> filename;
+	if( p == filenameEnd )
+	{
+		error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading texture map, skipping it." );
+		return;
+	}
+
+	if( table )
+	{
+		if( table->current() )
+			table->addMap( map, p, filenameEnd );
+	}
+	else if( signal )
+	{
+		_buffer.assign( p, filenameEnd );
+		signal->send( _buffer );
+	}
+}
+
+template<bool Profile>
+bool mtlparser::parseMapOption( const char*& p, const char* end, texturemap& map )
+{
+	static const char* const channels[] = { "r", "g", "b", "m", "l", "z" };
+	static const char* const projections[] = { "sphere", "cube_top", "cube_bottom", "cube_front", "cube_back", "cube_left", "cube_right" };
+
+	const char* option = p;
+	const char* optionEnd = scanner::skipToken( p, end );
+	p = scanner::skipSpace( optionEnd, end );
+
+	bool ok;
+
+	if( scanner::equals( option, optionEnd, "-blendu" ) )
+		ok = readOptionSwitch( p, end, texturemap::BLEND_U, map.flags );
+	else if( scanner::equals( option, optionEnd, "-blendv" ) )
+		ok = readOptionSwitch( p, end, texturemap::BLEND_V, map.flags );
+	else if( scanner::equals( option, optionEnd, "-clamp" ) )
+		ok = readOptionSwitch( p, end, texturemap::CLAMP, map.flags );
+	else if( scanner::equals( option, optionEnd, "-cc" ) )
+		ok = readOptionSwitch( p, end, texturemap::COLOR_CORRECTION, map.flags );
+	else if( scanner::equals( option, optionEnd, "-bm" ) )
+		ok = readOptionValue( p, end, map.bumpMultiplier );
+	else if( scanner::equals( option, optionEnd, "-boost" ) )
+		ok = readOptionValue( p, end, map.boost );
+	else if( scanner::equals( option, optionEnd, "-mm" ) )
+		ok = readOptionValue( p, end, map.base ) && readOptionValue( p, end, map.gain );
+	else if( scanner::equals( option, optionEnd, "-o" ) )
+		ok = readOptionVector( p, end, map.origin );
+	else if( scanner::equals( option, optionEnd, "-s" ) )
+		ok = readOptionVector( p, end, map.scale );
+	else if( scanner::equals( option, optionEnd, "-t" ) )
+		ok = readOptionVector( p, end, map.turbulence );
+	else if( scanner::equals( option, optionEnd, "-texres" ) )
+		ok = readOptionValue( p, end, map.resolution );
+	else if( scanner::equals( option, optionEnd, "-imfchan" ) )
+		ok = readOptionWord( p, end, channels, 6, texturemap::CHANNEL_R, map.channel );
+	else if( scanner::equals( option, optionEnd, "-type" ) )
+		ok = readOptionWord( p, end, projections, 7, texturemap::SPHERE, map.projection );
+	else
+	{
+		error<Profile>( parsestats::UNSUPPORTED_ERROR, "Unknown texture map option '", option, optionEnd, "', skipping texture map." );
+		return false;
+	}
 
-	if( ss.fail() )
+	if( !ok )
 	{
-		errorSignal.send( lineNumber, "Parse error reading texture map, skipping it." );
+		error<Profile>( parsestats::MALFORMED_ERROR, "Parse error reading texture map option '", option, optionEnd, "', skipping texture map." );
 		return false;
 	}
 
@@ -0,0 +1,392 @@
+#include <obj/multiparser.h>
+#include "mappedfile.h"
+#include "objchunk.h"
+#include "scanner.h"
+#include "thread.h"
+#include "decompressor.h"
+#include <algorithm>
+#include <deque>
+
+using namespace obj;
+
+// Size of line ranges recorded by each worker, larger files are split
+static const size_t PART_SIZE = 4 << 20;
+
+// Recorded parts per worker that may wait to be sent before workers stop starting new files
+static const size_t MAX_PENDING_PARTS = 2;
+
+// Parts of one file recorded ahead of the one being sent, per worker
+static const unsigned int SLOTS_PER_WORKER = 2;
+
+namespace
+{
+	// Recording of one file, sent part by part
+	template<typename Real>
+	struct filestate
+	{
+		filestate()
+			: mapping( 0 ), numParts( 0 ), nextPart( 0 ), numReplayed( 0 ), deferred( false )
+		{
+			// empty
+		}
+
+		mappedfile* mapping;
+
+		// Part i is [bounds[i], bounds[i + 1])
+		std::vector<const char*> bounds;
+
+		// Part i is recorded into slot i % slots.size() once the previous user of the slot was replayed
+		std::vector< objchunk<Real> > slots;
+		std::vector<bool> recorded;
+
+		unsigned int numParts;
+		unsigned int nextPart;
+		unsigned int numReplayed;
+
+		// Parsed on the calling thread instead
+		bool deferred;
+
+		size_t partSize( unsigned int i ) const { return bounds[i + 1] - bounds[i]; }
+
+		// Part not taken yet whose slot is free
+		bool hasFreeSlot() const { return nextPart < numParts && nextPart < numReplayed + slots.size(); }
+	};
+
+	// Part of a file taken by a worker
+	struct filepart
+	{
+		unsigned int file;
+		unsigned int index;
+	};
+
+	// Shared state of a multiparser parse
+	template<typename Real>
+	struct multiparse
+	{
+		const std::vector<std::string>* filenames;
+		std::vector< filestate<Real> > files;
+
+		// Files from nextFile on not mapped yet
+		unsigned int nextFile;
+
+		// Mapped or deferred files not completely sent, in the order they were started, the front one is being sent
+		std::deque<unsigned int> started;
+
+		// Bytes of recorded parts not sent yet
+		size_t pendingBytes;
+		size_t maxPendingBytes;
+
+		unsigned int slotsPerFile;
+		bool convertNegativeIndices;
+		bool profile;
+		bool stopped;
+
+		mutex guard;
+		condition changed;
+	};
+
+	// End of line range starting at p of at least given size, or end
+	const char* partEnd( const char* p, const char* end, size_t size )
+	{
+		if( (size_t)( end - p ) <= size )
+			return end;
+
+		p = scanner::findLineEnd( p + size, end );
+		return ( p != end ) ? p + 1 : end;
+	}
+
+	// Called with guard held, earliest started file first so the one being sent never waits for later ones
+	template<typename Real>
+	bool takePart( multiparse<Real>& state, filepart& part )
+	{
+		for( size_t i = 0; i < state.started.size(); ++i )
+		{
+			filestate<Real>& f = state.files[state.started[i]];
+			if( !f.hasFreeSlot() )
+				continue;
+
+			part.file = state.started[i];
+			part.index = f.nextPart++;
+			return true;
+		}
+
+		return false;
+	}
+
+	// Called with guard held, whether started files have parts left to take
+	template<typename Real>
+	bool hasPartsLeft( const multiparse<Real>& state )
+	{
+		for( size_t i = 0; i < state.started.size(); ++i )
+		{
+			const filestate<Real>& f = state.files[state.started[i]];
+			if( f.nextPart < f.numParts )
+				return true;
+		}
+
+		return false;
+	}
+
+	// Map file and split it into parts, the first of which is returned in part
+	template<typename Real>
+	bool startFile( multiparse<Real>& state, unsigned int file, filepart& part )
+	{
+		mappedfile* mapping = new mappedfile();
+
+		if( !mapping->open( (*state.filenames)[file].c_str() ) ||
+			decompressor::detect( mapping->data(), mapping->size() ) != decompressor::NONE )
+		{
+			delete mapping;
+
+			scoped_lock lock( state.guard );
+			state.files[file].deferred = true;
+			state.started.push_back( file );
+			state.changed.notifyAll();
+			return false;
+		}
+
+		std::vector<const char*> bounds;
+		const char* end = mapping->data() + mapping->size();
+
+		bounds.push_back( mapping->data() );
+		for( const char* p = mapping->data(); p != end; bounds.push_back( p ) )
+			p = partEnd( p, end, PART_SIZE );
+
+		scoped_lock lock( state.guard );
+
+		filestate<Real>& f = state.files[file];
+		f.mapping = mapping;
+		f.bounds.swap( bounds );
+		f.numParts = (unsigned int)f.bounds.size() - 1;
+		f.slots.resize( std::min( f.numParts, state.slotsPerFile ) );
+		f.recorded.assign( f.slots.size(), false );
+
+		state.started.push_back( file );
+		state.changed.notifyAll();
+
+		// Empty file
+		if( f.numParts == 0 )
+			return false;
+
+		part.file = file;
+		part.index = f.nextPart++;
+		return true;
+	}
+
+	template<typename Real>
+	void parseFiles( void* arg )
+	{
+		multiparse<Real>& state = *(multiparse<Real>*)arg;
+
+		while( true )
+		{
+			filepart part;
+			unsigned int file = 0;
+			bool isNewFile = false;
+			{
+				scoped_lock lock( state.guard );
+
+				// Parts of started files first, new files while few recorded parts wait
+				while( true )
+				{
+					if( state.stopped )
+						return;
+
+					if( takePart( state, part ) )
+						break;
+
+					if( state.nextFile < state.files.size() && state.pendingBytes < state.maxPendingBytes )
+					{
+						file = state.nextFile++;
+						isNewFile = true;
+						break;
+					}
+
+					// Workers that started the remaining files take their parts
+					if( state.nextFile >= state.files.size() && !hasPartsLeft( state ) )
+						return;
+
+					state.changed.wait( state.guard );
+				}
+			}
+
+			if( isNewFile && !startFile( state, file, part ) )
+				continue;
+
+			// Slot was given back by the calling thread, nobody else uses it until it is recorded
+			filestate<Real>& f = state.files[part.file];
+			const size_t slot = part.index % f.slots.size();
+			f.slots[slot].record( f.bounds[part.index], f.bounds[part.index + 1], state.convertNegativeIndices, state.profile );
+
+			scoped_lock lock( state.guard );
+			f.recorded[slot] = true;
+			state.pendingBytes += f.partSize( part.index );
+			state.changed.notifyAll();
+		}
+	}
+
+	template<typename Real>
+	void releaseFile( filestate<Real>& f )
+	{
+		std::vector< objchunk<Real> >().swap( f.slots );
+		std::vector<const char*>().swap( f.bounds );
+
+		delete f.mapping;
+		f.mapping = 0;
+	}
+
+	void joinAll( std::vector<thread*>& threads )
+	{
+		for( size_t i = 0; i < threads.size(); ++i )
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+		threads.clear();
+	}
+}
+
+template<typename Real>
+basic_multiparser<Real>::basic_multiparser()
+{
+	numThreads = 0;
+}
+
+template<typename Real>
+void basic_multiparser<Real>::parse( const std::vector<std::string>& filenames )
+{
+	const unsigned int workers = ( numThreads == 0 ) ? thread::hardwareConcurrency() : numThreads;
+
+	// Caches are written by parser itself
+	if( workers < 2 || filenames.size() < 2 || !parser.cacheDirectory.empty() )
+	{
+		parseSerial( filenames );
+		return;
+	}
+
+	multiparse<Real> state;
+	state.filenames = &filenames;
+	state.files.resize( filenames.size() );
+	state.nextFile = 0;
+	state.pendingBytes = 0;
+	state.maxPendingBytes = MAX_PENDING_PARTS * workers * PART_SIZE;
+	state.slotsPerFile = SLOTS_PER_WORKER * workers;
+	state.convertNegativeIndices = parser.convertNegativeIndices;
+	state.profile = ( parser.stats != 0 );
+	state.stopped = false;
+
+	std::vector<thread*> threads;
+	for( unsigned int i = 0; i < workers; ++i )
+	{
+		thread* t = new thread();
+		if( t->start( parseFiles<Real>, &state ) )
+			threads.push_back( t );
+		else
+			delete t;
+	}
+
+	// Nothing sent yet, parse on this thread instead
+	if( threads.empty() )
+	{
+		parseSerial( filenames );
+		return;
+	}
+
+	try
+	{
+		for( size_t i = 0; i < filenames.size(); ++i )
+		{
+			unsigned int file;
+			{
+				scoped_lock lock( state.guard );
+				while( state.started.empty() )
+					state.changed.wait( state.guard );
+
+				file = state.started.front();
+			}
+
+			filestate<Real>& f = state.files[file];
+
+			fileBeginSignal.send( file, filenames[file] );
+
+			if( f.deferred )
+			{
+				parser.parse( filenames[file].c_str() );
+			}
+			else
+			{
+				// Parts in file order as soon as each is recorded, counts of all preceding parts are the running totals
+				parser.reset();
+
+				for( unsigned int k = 0; k < f.numParts; ++k )
+				{
+					const size_t slot = k % f.slots.size();
+					{
+						scoped_lock lock( state.guard );
+						while( !f.recorded[slot] )
+							state.changed.wait( state.guard );
+					}
+
+					parser.replayChunk( f.slots[slot] );
+
+					scoped_lock lock( state.guard );
+					f.recorded[slot] = false;
+					++f.numReplayed;
+					state.pendingBytes -= f.partSize( k );
+					state.changed.notifyAll();
+				}
+
+				parser.endParse();
+			}
+
+			fileEndSignal.send( file );
+
+			// All parts were taken and sent, no worker uses the file anymore
+			{
+				scoped_lock lock( state.guard );
+				state.started.pop_front();
+				state.changed.notifyAll();
+			}
+
+			releaseFile( f );
+		}
+	}
+	catch( ... )
+	{
+		// Exception from a slot, stop workers before leaving
+		{
+			scoped_lock lock( state.guard );
+			state.stopped = true;
+			state.changed.notifyAll();
+		}
+
+		joinAll( threads );
+
+		for( size_t i = 0; i < state.files.size(); ++i )
+			releaseFile( state.files[i] );
+
+		throw;
+	}
+
+	joinAll( threads );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void basic_multiparser<Real>::parseSerial( const std::vector<std::string>& filenames )
+{
+	for( size_t i = 0; i < filenames.size(); ++i )
+	{
+		fileBeginSignal.send( (unsigned int)i, filenames[i] );
+		parser.parse( filenames[i].c_str() );
+		fileEndSignal.send( (unsigned int)i );
+	}
+}
+
+namespace obj
+{
+	template class basic_multiparser<double>;
+	template class basic_multiparser<float>;
+}
@@ -0,0 +1,410 @@
+#include "objcache.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <process.h>
+#else
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace obj;
+
+namespace
+{
+	const char MAGIC[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+
+	// Increment whenever objchunk commands or the layout below change
+	const unsigned long long VERSION = 4;
+
+	// Written as is, reads back differently on machines of other byte order
+	const unsigned long long ENDIAN_TAG = 0x0102030405060708ull;
+
+	// Sizes of the records stored as raw arrays
+	template<typename Real>
+	unsigned long long layout()
+	{
+		return ( sizeof( typename objchunk<Real>::command ) << 16 ) | ( sizeof( vec3<Real> ) << 8 ) | sizeof( face_index );
+	}
+
+	struct fileheader
+	{
+		char magic[8];
+		unsigned long long version;
+		unsigned long long byteOrder;
+		unsigned long long layout;
+		unsigned long long flags;
+		unsigned long long sourceSize;
+		long long sourceTime;
+		unsigned long long sourceHash;
+		unsigned long long pathSize;	// source path follows header
+		unsigned long long numChunks;
+		unsigned long long complete;	// set once everything else was written
+	};
+
+	// Followed by arrays in view order, each padded to 8 bytes
+	struct chunkheader
+	{
+		unsigned long long size;		// including header
+		unsigned long long baseLine;
+		unsigned long long numCommands;
+		unsigned long long numVertices;
+		unsigned long long numWeights;
+		unsigned long long numColors;
+		unsigned long long numNormals;
+		unsigned long long numTexCoords;
+		unsigned long long numParameters;
+		unsigned long long numFaces;
+		unsigned long long numFaceElements;
+		unsigned long long numStrings;
+		unsigned long long textSize;
+	};
+
+	unsigned long long padded( unsigned long long size )
+	{
+		return ( size + 7 ) & ~7ull;
+	}
+
+	// Non cryptographic 64 bit hash, reads 8 bytes at a time
+	unsigned long long hashBytes( const char* data, size_t size )
+	{
+		const unsigned long long MULTIPLIER = 0x9e3779b97f4a7c15ull;
+		unsigned long long h = size * MULTIPLIER;
+
+		size_t i = 0;
+		for( ; i + 8 <= size; i += 8 )
+		{
+			unsigned long long word;
+			memcpy( &word, data + i, 8 );
+			h = ( h ^ word ) * MULTIPLIER;
+			h ^= h >> 29;
+		}
+
+		unsigned long long tail = 0;
+		if( i < size )
+			memcpy( &tail, data + i, size - i );
+		h = ( h ^ tail ) * MULTIPLIER;
+		h ^= h >> 32;
+		return h;
+	}
+
+	// Take array of count elements from mapped chunk
+	template<typename T>
+	bool takeArray( const char*& p, const char* end, unsigned long long count, const T*& array )
+	{
+		if( count > (unsigned long long)( end - p ) / sizeof( T ) )
+			return false;
+
+		const unsigned long long size = padded( count * sizeof( T ) );
+		if( size > (unsigned long long)( end - p ) )
+			return false;
+
+		array = count ? (const T*)p : 0;
+		p += size;
+		return true;
+	}
+
+	std::string toHex( unsigned long long value )
+	{
+		char buffer[17];
+		sprintf( buffer, "%016llx", value );
+		return buffer;
+	}
+}
+
+template<typename Real>
+objcache<Real>::objcache( const std::string& directory, const char* sourceFile, bool convertNegativeIndices )
+	: _sourceFile( sourceFile ), _flags( convertNegativeIndices ? 1 : 0 ), _sourceSize( 0 ), _sourceTime( 0 ),
+	  _offset( 0 ), _sourceHash( 0 ), _numChunks( 0 ), _writing( false )
+{
+	// One cache per source path and precision
+	_cacheFile = directory;
+	if( !_cacheFile.empty() && _cacheFile[_cacheFile.size() - 1] != '/' && _cacheFile[_cacheFile.size() - 1] != '\\' )
+		_cacheFile += '/';
+	_cacheFile += toHex( hashBytes( _sourceFile.data(), _sourceFile.size() ) );
+	_cacheFile += ( sizeof( Real ) == sizeof( float ) ) ? ".f.objcache" : ".objcache";
+
+	_identified = identifySource();
+}
+
+template<typename Real>
+objcache<Real>::~objcache()
+{
+	discard();
+}
+
+template<typename Real>
+bool objcache<Real>::open( const char* data, size_t size, bool checkContent )
+{
+	if( !_identified || !_mapping.open( _cacheFile.c_str() ) )
+		return false;
+
+	const char* p = _mapping.data();
+	const char* end = p + _mapping.size();
+
+	fileheader header;
+	if( _mapping.size() < sizeof( header ) )
+		return false;
+
+	memcpy( &header, p, sizeof( header ) );
+	p += sizeof( header );
+
+	if( memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.version != VERSION ||
+		header.byteOrder != ENDIAN_TAG || header.layout != layout<Real>() || header.flags != _flags ||
+		header.complete != 1 || header.sourceSize != _sourceSize || header.sourceTime != _sourceTime ||
+		header.pathSize != _sourceFile.size() || padded( header.pathSize ) > (unsigned long long)( end - p ) ||
+		memcmp( p, _sourceFile.data(), _sourceFile.size() ) != 0 )
+		return false;
+
+	p += padded( header.pathSize );
+
+	if( checkContent && ( size != _sourceSize || hashBytes( data, size ) != header.sourceHash ) )
+		return false;
+
+	// Check all chunks now, nothing may be sent before the whole cache is known to be usable
+	_offset = p - _mapping.data();
+
+	typename objchunk<Real>::view v;
+	unsigned int baseLine;
+	unsigned long long numChunks = 0;
+
+	while( next( v, baseLine ) )
+	{
+		if( !v.isValid() )
+			break;
+		++numChunks;
+	}
+
+	if( numChunks != header.numChunks || _offset != _mapping.size() )
+		return false;
+
+	_offset = p - _mapping.data();
+	return true;
+}
+
+template<typename Real>
+bool objcache<Real>::next( typename objchunk<Real>::view& v, unsigned int& baseLine )
+{
+	const char* p = _mapping.data() + _offset;
+	const char* end = _mapping.data() + _mapping.size();
+
+	chunkheader header;
+	if( (size_t)( end - p ) < sizeof( header ) )
+		return false;
+
+	memcpy( &header, p, sizeof( header ) );
+
+	if( header.size < sizeof( header ) || header.size > (unsigned long long)( end - p ) )
+		return false;
+
+	end = p + header.size;
+	p += sizeof( header );
+
+	if( !takeArray( p, end, header.numCommands, v.commands ) ||
+		!takeArray( p, end, header.numVertices, v.vertices ) ||
+		!takeArray( p, end, header.numWeights, v.weights ) ||
+		!takeArray( p, end, header.numColors, v.colors ) ||
+		!takeArray( p, end, header.numNormals, v.normals ) ||
+		!takeArray( p, end, header.numTexCoords, v.texcoords ) ||
+		!takeArray( p, end, header.numParameters, v.parameters ) ||
+		!takeArray( p, end, header.numFaces, v.faceSizes ) ||
+		!takeArray( p, end, header.numFaceElements, v.faceElements ) ||
+		!takeArray( p, end, header.numStrings, v.textEnds ) ||
+		!takeArray( p, end, header.textSize, v.text ) )
+		return false;
+
+	v.numCommands = (size_t)header.numCommands;
+	v.numVertices = (size_t)header.numVertices;
+	v.numWeights = (size_t)header.numWeights;
+	v.numColors = (size_t)header.numColors;
+	v.numNormals = (size_t)header.numNormals;
+	v.numTexCoords = (size_t)header.numTexCoords;
+	v.numParameters = (size_t)header.numParameters;
+	v.numFaces = (size_t)header.numFaces;
+	v.numFaceElements = (size_t)header.numFaceElements;
+	v.numStrings = (size_t)header.numStrings;
+	v.textSize = (size_t)header.textSize;
+	baseLine = (unsigned int)header.baseLine;
+
+	_offset = end - _mapping.data();
+	return true;
+}
+
+template<typename Real>
+bool objcache<Real>::create( const char* data, size_t size )
+{
+	if( !_identified || size != _sourceSize )
+		return false;
+
+	_mapping.close();
+
+	// Unique name, concurrent writers of the same cache do not mix their output
+#ifdef _WIN32
+	const unsigned long long pid = (unsigned long long)_getpid();
+#else
+	const unsigned long long pid = (unsigned long long)getpid();
+#endif
+	_tempFile = _cacheFile + "." + toHex( pid ^ (unsigned long long)(size_t)this );
+
+	_output.open( _tempFile.c_str(), std::ios::binary | std::ios::trunc );
+	if( !_output )
+		return false;
+
+	_writing = true;
+	_sourceHash = hashBytes( data, size );
+	_numChunks = 0;
+
+	// Header is written again by commit()
+	fileheader header;
+	memset( &header, 0, sizeof( header ) );
+	_output.write( (const char*)&header, sizeof( header ) );
+	writeArray( _sourceFile.data(), _sourceFile.size() );
+
+	return _output.good();
+}
+
+template<typename Real>
+void objcache<Real>::write( const objchunk<Real>& chunk, unsigned int baseLine )
+{
+	if( !_writing )
+		return;
+
+	const typename objchunk<Real>::view v = chunk.getView();
+
+	chunkheader header;
+	header.baseLine = baseLine;
+	header.numCommands = v.numCommands;
+	header.numVertices = v.numVertices;
+	header.numWeights = v.numWeights;
+	header.numColors = v.numColors;
+	header.numNormals = v.numNormals;
+	header.numTexCoords = v.numTexCoords;
+	header.numParameters = v.numParameters;
+	header.numFaces = v.numFaces;
+	header.numFaceElements = v.numFaceElements;
+	header.numStrings = v.numStrings;
+	header.textSize = v.textSize;
+	header.size = sizeof( header ) +
+		padded( v.numCommands * sizeof( typename objchunk<Real>::command ) ) +
+		padded( v.numVertices * sizeof( vec3<Real> ) ) +
+		padded( v.numWeights * sizeof( Real ) ) +
+		padded( v.numColors * sizeof( vec3<Real> ) ) +
+		padded( v.numNormals * sizeof( vec3<Real> ) ) +
+		padded( v.numTexCoords * sizeof( vec3<Real> ) ) +
+		padded( v.numParameters * sizeof( vec3<Real> ) ) +
+		padded( v.numFaces * sizeof( unsigned int ) ) +
+		padded( v.numFaceElements * sizeof( face_index ) ) +
+		padded( v.numStrings * sizeof( unsigned int ) ) +
+		padded( v.textSize );
+
+	_output.write( (const char*)&header, sizeof( header ) );
+	writeArray( v.commands, v.numCommands * sizeof( typename objchunk<Real>::command ) );
+	writeArray( v.vertices, v.numVertices * sizeof( vec3<Real> ) );
+	writeArray( v.weights, v.numWeights * sizeof( Real ) );
+	writeArray( v.colors, v.numColors * sizeof( vec3<Real> ) );
+	writeArray( v.normals, v.numNormals * sizeof( vec3<Real> ) );
+	writeArray( v.texcoords, v.numTexCoords * sizeof( vec3<Real> ) );
+	writeArray( v.parameters, v.numParameters * sizeof( vec3<Real> ) );
+	writeArray( v.faceSizes, v.numFaces * sizeof( unsigned int ) );
+	writeArray( v.faceElements, v.numFaceElements * sizeof( face_index ) );
+	writeArray( v.textEnds, v.numStrings * sizeof( unsigned int ) );
+	writeArray( v.text, v.textSize );
+
+	++_numChunks;
+}
+
+template<typename Real>
+bool objcache<Real>::commit()
+{
+	if( !_writing )
+		return false;
+
+	fileheader header;
+	memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+	header.version = VERSION;
+	header.byteOrder = ENDIAN_TAG;
+	header.layout = layout<Real>();
+	header.flags = _flags;
+	header.sourceSize = _sourceSize;
+	header.sourceTime = _sourceTime;
+	header.sourceHash = _sourceHash;
+	header.pathSize = _sourceFile.size();
+	header.numChunks = _numChunks;
+	header.complete = 1;
+
+	_output.seekp( 0 );
+	_output.write( (const char*)&header, sizeof( header ) );
+	_output.close();
+
+	if( _output.fail() )
+	{
+		discard();
+		return false;
+	}
+
+	// Rename over an existing file fails on Windows
+	remove( _cacheFile.c_str() );
+	if( rename( _tempFile.c_str(), _cacheFile.c_str() ) != 0 )
+	{
+		discard();
+		return false;
+	}
+
+	_writing = false;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+bool objcache<Real>::identifySource()
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if( _stat64( _sourceFile.c_str(), &st ) != 0 )
+		return false;
+#else
+	struct stat st;
+	if( stat( _sourceFile.c_str(), &st ) != 0 )
+		return false;
+#endif
+
+	_sourceSize = (unsigned long long)st.st_size;
+	_sourceTime = (long long)st.st_mtime;
+	return true;
+}
+
+template<typename Real>
+void objcache<Real>::writeArray( const void* data, size_t size )
+{
+	static const char zeros[8] = { 0 };
+
+	if( size > 0 )
+		_output.write( (const char*)data, (std::streamsize)size );
+
+	_output.write( zeros, (std::streamsize)( padded( size ) - size ) );
+}
+
+template<typename Real>
+void objcache<Real>::discard()
+{
+	if( !_writing )
+		return;
+
+	if( _output.is_open() )
+		_output.close();
+
+	remove( _tempFile.c_str() );
+	_writing = false;
+}
+
+namespace obj
+{
+	template class objcache<double>;
+	template class objcache<float>;
+}
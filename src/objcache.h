@@ -0,0 +1,75 @@
+#ifndef _OBJ_OBJCACHE_H_
+#define _OBJ_OBJCACHE_H_
+
+#include "objchunk.h"
+#include "mappedfile.h"
+#include <fstream>
+#include <string>
+
+namespace obj
+{
+	/*
+	 *	Binary cache of the chunks recorded while parsing a file.
+	 *
+	 *	Chunks are stored after applyBase(), so replaying them in order
+	 *	sends the same signals as parsing the source again. The header
+	 *	identifies the source by path, size, modification time and content
+	 *	hash, plus the flags that change results; a cache that does not
+	 *	match is ignored and replaced by the next parse.
+	 *
+	 *	Arrays are written in native layout and byte order at 8 byte
+	 *	aligned offsets, replay reads them straight from the mapped file.
+	 *	Each precision has its own cache file.
+	 */
+	template<typename Real>
+	class objcache
+	{
+	public:
+		objcache( const std::string& directory, const char* sourceFile, bool convertNegativeIndices );
+		~objcache();
+
+		// Map cache and check it matches source, content hash is only compared if checkContent
+		bool open( const char* data, size_t size, bool checkContent );
+
+		// Next chunk of an open cache, arrays point into the mapped file
+		bool next( typename objchunk<Real>::view& v, unsigned int& baseLine );
+
+		// Start writing a new cache for source contents
+		bool create( const char* data, size_t size );
+
+		// Append chunk of a created cache
+		void write( const objchunk<Real>& chunk, unsigned int baseLine );
+
+		// Finish created cache and replace previous one, false if anything failed
+		bool commit();
+
+	private:
+		// Non copyable
+		objcache( const objcache& );
+		objcache& operator=( const objcache& );
+
+		bool identifySource();
+		void writeArray( const void* data, size_t size );
+		void discard();
+
+		std::string _sourceFile;
+		std::string _cacheFile;
+		std::string _tempFile;
+		unsigned long long _flags;
+		unsigned long long _sourceSize;
+		long long _sourceTime;
+		bool _identified;
+
+		// Reading
+		mappedfile _mapping;
+		size_t _offset;
+
+		// Writing
+		std::ofstream _output;
+		unsigned long long _sourceHash;
+		unsigned long long _numChunks;
+		bool _writing;
+	};
+}
+
+#endif // _OBJ_OBJCACHE_H_
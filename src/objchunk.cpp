@@ -0,0 +1,751 @@
+#include "objchunk.h"
+#include "objreader.h"
+#include "timer.h"
+#include <obj/objparser.h>
+#include <algorithm>
+
+using namespace obj;
+
+// Send array to sink in blocks
+template<typename Real>
+static void sendBlocks( basic_batchsink<Real>& sink, void (basic_batchsink<Real>::*f)( const vec3<Real>*, size_t ),
+						const vec3<Real>* data, size_t count, size_t blockSize )
+{
+	for( size_t i = 0; i < count; i += blockSize )
+		( sink.*f )( data + i, std::min( blockSize, count - i ) );
+}
+
+// Advance used by count if it stays within available
+static bool consume( size_t& used, size_t count, size_t available )
+{
+	if( count > available - used )
+		return false;
+
+	used += count;
+	return true;
+}
+
+template<typename Real>
+objchunk<Real>::objchunk( arena* memory )
+	: _commands( memory ), _vertices( memory ), _normals( memory ), _texcoords( memory ), _parameters( memory ),
+	  _weights( memory ), _colors( memory ), _faceSizes( memory ), _faceElements( memory ), _text( memory ),
+	  _textEnds( memory ), _fixups( memory )
+{
+	clear( true );
+}
+
+template<typename Real>
+void objchunk<Real>::clear( bool convertNegativeIndices )
+{
+	_convertNegativeIndices = convertNegativeIndices;
+	_lineNumber = 0;
+	_numVertices = 0;
+	_numNormals = 0;
+	_numTexCoords = 0;
+	_faceSize = 0;
+	_faceFlushed = 0;
+	_faceHasErrors = false;
+	_inFace = false;
+
+	_commands.clear();
+	_vertices.clear();
+	_normals.clear();
+	_texcoords.clear();
+	_parameters.clear();
+	_weights.clear();
+	_colors.clear();
+	_faceSizes.clear();
+	_faceElements.clear();
+	_text.clear();
+	_textEnds.clear();
+	_fixups.clear();
+	_stats.clear();
+}
+
+template<typename Real>
+void objchunk<Real>::record( const char* begin, const char* end, bool convertNegativeIndices, bool profile )
+{
+	clear( convertNegativeIndices );
+
+	if( !profile )
+	{
+		objreader< objchunk<Real> > reader( *this );
+		reader.parseLines( begin, end );
+		return;
+	}
+
+	const double start = now();
+
+	objreader< objchunk<Real>, true > reader( *this, &_stats );
+	reader.parseLines( begin, end );
+
+	_stats.tokenizeTime += now() - start - _stats.conversionTime;
+}
+
+template<typename Real>
+void objchunk<Real>::applyBase( int numVertices, int numTexCoords, int numNormals )
+{
+	for( size_t i = 0; i < _fixups.size(); ++i )
+	{
+		face_index& idx = _faceElements[_fixups[i] / 3];
+
+		switch( _fixups[i] % 3 )
+		{
+		case 0:
+			idx.vertexIdx += numVertices;
+			break;
+		case 1:
+			idx.texCoordIdx += numTexCoords;
+			break;
+		case 2:
+			idx.normalIdx += numNormals;
+			break;
+		}
+	}
+}
+
+template<typename Real>
+void objchunk<Real>::replay( basic_objparser<Real>& parser, unsigned int baseLine ) const
+{
+	replay( getView(), parser, baseLine );
+}
+
+template<typename Real>
+void objchunk<Real>::replay( const view& v, basic_objparser<Real>& parser, unsigned int baseLine )
+{
+	basic_batchsink<Real>* sink = parser.batchSink;
+	const size_t blockSize = ( parser.batchSize > 0 ) ? parser.batchSize : 1;
+
+	// Faces with element errors are sent at their end when all of their elements are needed at once
+	const bool whole = ( sink || parser.triangulate || parser.checkIndices );
+
+	size_t vertex = 0;
+	size_t weight = 0;
+	size_t color = 0;
+	size_t normal = 0;
+	size_t texcoord = 0;
+	size_t parameter = 0;
+	size_t face = 0;
+	size_t element = 0;
+	size_t faceStart = 0;
+	size_t text = 0;
+
+	// Recorded string of text commands
+	const char* textBegin = 0;
+	const char* textEnd = 0;
+	std::string str;
+
+	for( size_t i = 0; i < v.numCommands; ++i )
+	{
+		const command& c = v.commands[i];
+
+		// Positions of faces still to come, vertex runs are the first command types
+		if( parser.triangulate && c.type <= COLORED_VERTICES )
+			parser.addPositions( v.vertices + vertex, c.count );
+
+		if( c.type >= ERROR_MESSAGE )
+		{
+			textBegin = v.text + ( ( text > 0 ) ? v.textEnds[text - 1] : 0 );
+			textEnd = v.text + v.textEnds[text];
+			++text;
+		}
+
+		switch( c.type )
+		{
+		case VERTICES:
+			if( sink )
+				sendBlocks( *sink, &basic_batchsink<Real>::vertices, v.vertices + vertex, c.count, blockSize );
+			else
+				for( unsigned int j = 0; j < c.count; ++j )
+					parser.vertexSignal.send( v.vertices[vertex + j] );
+
+			vertex += c.count;
+			break;
+
+		case WEIGHTED_VERTICES:
+			if( sink )
+			{
+				for( unsigned int j = 0; j < c.count; j += blockSize )
+				{
+					const size_t count = std::min( blockSize, (size_t)( c.count - j ) );
+					sink->vertices( v.vertices + vertex + j, count );
+					sink->vertexWeights( v.weights + weight + j, count );
+				}
+			}
+			else
+			{
+				for( unsigned int j = 0; j < c.count; ++j )
+				{
+					parser.vertexSignal.send( v.vertices[vertex + j] );
+					parser.vertexWeightSignal.send( v.weights[weight + j] );
+				}
+			}
+
+			vertex += c.count;
+			weight += c.count;
+			break;
+
+		case COLORED_VERTICES:
+			if( sink )
+			{
+				for( unsigned int j = 0; j < c.count; j += blockSize )
+				{
+					const size_t count = std::min( blockSize, (size_t)( c.count - j ) );
+					sink->vertices( v.vertices + vertex + j, count );
+					sink->vertexColors( v.colors + color + j, count );
+				}
+			}
+			else
+			{
+				for( unsigned int j = 0; j < c.count; ++j )
+				{
+					parser.vertexSignal.send( v.vertices[vertex + j] );
+					parser.vertexColorSignal.send( v.colors[color + j] );
+				}
+			}
+
+			vertex += c.count;
+			color += c.count;
+			break;
+
+		case NORMALS:
+			if( sink )
+				sendBlocks( *sink, &basic_batchsink<Real>::normals, v.normals + normal, c.count, blockSize );
+			else
+				for( unsigned int j = 0; j < c.count; ++j )
+					parser.normalSignal.send( v.normals[normal + j] );
+
+			normal += c.count;
+			break;
+
+		case TEXCOORDS:
+			if( sink )
+				sendBlocks( *sink, &basic_batchsink<Real>::texcoords, v.texcoords + texcoord, c.count, blockSize );
+			else
+				for( unsigned int j = 0; j < c.count; ++j )
+					parser.texcoordSignal.send( v.texcoords[texcoord + j] );
+
+			texcoord += c.count;
+			break;
+
+		case PARAMETERS:
+			if( sink )
+				sendBlocks( *sink, &basic_batchsink<Real>::parameters, v.parameters + parameter, c.count, blockSize );
+			else
+				for( unsigned int j = 0; j < c.count; ++j )
+					parser.parameterSignal.send( v.parameters[parameter + j] );
+
+			parameter += c.count;
+			break;
+
+		case FACES:
+			if( parser.checkIndices )
+			{
+				// Runs hold faces of consecutive lines, valid faces are sent as runs between the skipped ones
+				for( unsigned int j = 0; j < c.count; )
+				{
+					unsigned int numValid = 0;
+					for( size_t e = element; j + numValid < c.count; e += v.faceSizes[face + numValid++] )
+					{
+						if( !parser.isInRange( v.faceElements + e, v.faceSizes[face + numValid], vertex, texcoord, normal ) )
+							break;
+					}
+
+					sendFaces( v, parser, face, element, numValid );
+					j += numValid;
+
+					if( j < c.count )
+					{
+						parser.rangeError( baseLine + c.line + j );
+						element += v.faceSizes[face++];
+						++j;
+					}
+				}
+			}
+			else
+			{
+				sendFaces( v, parser, face, element, c.count );
+			}
+			break;
+
+		case FACE_BEGIN:
+			if( !whole )
+				parser.faceBeginSignal.send( c.count );
+
+			faceStart = element;
+			break;
+
+		case FACE_ELEMENTS:
+			if( !whole )
+				for( unsigned int j = 0; j < c.count; ++j )
+					parser.faceElementSignal.send( v.faceElements[element + j] );
+
+			element += c.count;
+			break;
+
+		case FACE_END:
+			if( whole )
+			{
+				// Sent as a face of its valid elements, after its errors
+				const unsigned int size = (unsigned int)( element - faceStart );
+				const face_index* elements = v.faceElements + faceStart;
+
+				if( parser.checkIndices && !parser.isInRange( elements, size, vertex, texcoord, normal ) )
+				{
+					parser.rangeError( baseLine + c.line );
+				}
+				else if( parser.triangulate )
+				{
+					if( sink )
+						parser.sendTriangles( &size, 1, elements );
+					else
+						parser.sendFace( elements, size );
+				}
+				else if( sink )
+				{
+					sink->faces( &size, 1, elements, size );
+				}
+				else
+				{
+					parser.faceBeginSignal.send( size );
+					for( unsigned int j = 0; j < size; ++j )
+						parser.faceElementSignal.send( elements[j] );
+					parser.faceEndSignal.send();
+				}
+			}
+			else
+			{
+				parser.faceEndSignal.send();
+			}
+			break;
+
+		case SMOOTHING_GROUP:
+			parser.smoothingGroupSignal.send( c.count );
+			break;
+
+		case ERROR_MESSAGE:
+			str.assign( textBegin, textEnd );
+			parser.errorSignal.send( baseLine + c.line, str );
+			break;
+
+		case COMMENT:
+			str.assign( textBegin, textEnd );
+			parser.commentSignal.send( baseLine + c.line, str );
+			break;
+
+		// Names are interned by parser
+		case OBJECT_NAME:
+			parser.objectName( textBegin, textEnd );
+			break;
+
+		case GROUP_NAME:
+			parser.groupName( textBegin, textEnd );
+			break;
+
+		case MATERIAL_LIB:
+			str.assign( textBegin, textEnd );
+			parser.materialLibSignal.send( str );
+			break;
+
+		case MATERIAL_USE:
+			parser.materialUse( textBegin, textEnd );
+			break;
+		}
+	}
+}
+
+template<typename Real>
+typename objchunk<Real>::view objchunk<Real>::getView() const
+{
+	view v;
+	v.commands = _commands.empty() ? 0 : &_commands[0];
+	v.numCommands = _commands.size();
+	v.vertices = _vertices.empty() ? 0 : &_vertices[0];
+	v.numVertices = _vertices.size();
+	v.weights = _weights.empty() ? 0 : &_weights[0];
+	v.numWeights = _weights.size();
+	v.colors = _colors.empty() ? 0 : &_colors[0];
+	v.numColors = _colors.size();
+	v.normals = _normals.empty() ? 0 : &_normals[0];
+	v.numNormals = _normals.size();
+	v.texcoords = _texcoords.empty() ? 0 : &_texcoords[0];
+	v.numTexCoords = _texcoords.size();
+	v.parameters = _parameters.empty() ? 0 : &_parameters[0];
+	v.numParameters = _parameters.size();
+	v.faceSizes = _faceSizes.empty() ? 0 : &_faceSizes[0];
+	v.numFaces = _faceSizes.size();
+	v.faceElements = _faceElements.empty() ? 0 : &_faceElements[0];
+	v.numFaceElements = _faceElements.size();
+	v.textEnds = _textEnds.empty() ? 0 : &_textEnds[0];
+	v.numStrings = _textEnds.size();
+	v.text = _text.empty() ? 0 : &_text[0];
+	v.textSize = _text.size();
+	return v;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// view
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+bool objchunk<Real>::view::isValid() const
+{
+	size_t vertex = 0;
+	size_t weight = 0;
+	size_t color = 0;
+	size_t normal = 0;
+	size_t texcoord = 0;
+	size_t parameter = 0;
+	size_t face = 0;
+	size_t element = 0;
+	size_t text = 0;
+
+	for( size_t i = 0; i < numCommands; ++i )
+	{
+		const command& c = commands[i];
+		bool ok = true;
+
+		switch( c.type )
+		{
+		case VERTICES:
+			ok = consume( vertex, c.count, numVertices );
+			break;
+
+		case WEIGHTED_VERTICES:
+			ok = consume( vertex, c.count, numVertices ) && consume( weight, c.count, numWeights );
+			break;
+
+		case COLORED_VERTICES:
+			ok = consume( vertex, c.count, numVertices ) && consume( color, c.count, numColors );
+			break;
+
+		case NORMALS:
+			ok = consume( normal, c.count, numNormals );
+			break;
+
+		case TEXCOORDS:
+			ok = consume( texcoord, c.count, numTexCoords );
+			break;
+
+		case PARAMETERS:
+			ok = consume( parameter, c.count, numParameters );
+			break;
+
+		case FACES:
+			ok = consume( face, c.count, numFaces );
+			for( size_t j = face - c.count; ok && j < face; ++j )
+				ok = consume( element, faceSizes[j], numFaceElements );
+			break;
+
+		case FACE_BEGIN:
+		case FACE_END:
+		case SMOOTHING_GROUP:
+			break;
+
+		case FACE_ELEMENTS:
+			ok = consume( element, c.count, numFaceElements );
+			break;
+
+		case ERROR_MESSAGE:
+		case COMMENT:
+		case OBJECT_NAME:
+		case GROUP_NAME:
+		case MATERIAL_LIB:
+		case MATERIAL_USE:
+			ok = consume( text, 1, numStrings );
+			break;
+
+		default:
+			ok = false;
+			break;
+		}
+
+		if( !ok )
+			return false;
+	}
+
+	// String ends must be increasing and inside text
+	unsigned int previous = 0;
+	for( size_t i = 0; i < numStrings; ++i )
+	{
+		if( textEnds[i] < previous || textEnds[i] > textSize )
+			return false;
+		previous = textEnds[i];
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// objreader handler
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void objchunk<Real>::nextLine()
+{
+	++_lineNumber;
+}
+
+template<typename Real>
+void objchunk<Real>::error( const std::string& message )
+{
+	// Element errors split the face into separate commands to keep signal order
+	if( _inFace )
+	{
+		if( !_faceHasErrors )
+		{
+			_faceHasErrors = true;
+			append( FACE_BEGIN, _faceSize );
+		}
+
+		flushFaceElements();
+	}
+
+	appendString( ERROR_MESSAGE, message );
+}
+
+template<typename Real>
+void objchunk<Real>::comment( const std::string& text )
+{
+	appendString( COMMENT, text );
+}
+
+template<typename Real>
+void objchunk<Real>::vertex( const vector_type& v )
+{
+	appendRun( VERTICES );
+	_vertices.push_back( v );
+	++_numVertices;
+}
+
+template<typename Real>
+void objchunk<Real>::weightedVertex( const vector_type& v, real_type w )
+{
+	appendRun( WEIGHTED_VERTICES );
+	_vertices.push_back( v );
+	_weights.push_back( w );
+	++_numVertices;
+}
+
+template<typename Real>
+void objchunk<Real>::coloredVertex( const vector_type& v, const vector_type& color )
+{
+	appendRun( COLORED_VERTICES );
+	_vertices.push_back( v );
+	_colors.push_back( color );
+	++_numVertices;
+}
+
+template<typename Real>
+void objchunk<Real>::normal( const vector_type& n )
+{
+	appendRun( NORMALS );
+	_normals.push_back( n );
+	++_numNormals;
+}
+
+template<typename Real>
+void objchunk<Real>::texcoord( const vector_type& t )
+{
+	appendRun( TEXCOORDS );
+	_texcoords.push_back( t );
+	++_numTexCoords;
+}
+
+template<typename Real>
+void objchunk<Real>::parameter( const vector_type& p )
+{
+	appendRun( PARAMETERS );
+	_parameters.push_back( p );
+}
+
+template<typename Real>
+void objchunk<Real>::faceBegin( unsigned int numElements )
+{
+	_inFace = true;
+	_faceHasErrors = false;
+	_faceSize = numElements;
+	_faceFlushed = _faceElements.size();
+}
+
+template<typename Real>
+void objchunk<Real>::faceElement( face_index& idx )
+{
+	// Convert against local counts, preceding chunks are added by applyBase()
+	if( _convertNegativeIndices )
+	{
+		unsigned int element = (unsigned int)_faceElements.size();
+
+		if( idx.vertexIdx < 0 )
+		{
+			idx.vertexIdx += _numVertices + 1;
+			_fixups.push_back( element * 3 + 0 );
+		}
+
+		if( idx.texCoordIdx < 0 )
+		{
+			idx.texCoordIdx += _numTexCoords + 1;
+			_fixups.push_back( element * 3 + 1 );
+		}
+
+		if( idx.normalIdx < 0 )
+		{
+			idx.normalIdx += _numNormals + 1;
+			_fixups.push_back( element * 3 + 2 );
+		}
+	}
+
+	_faceElements.push_back( idx );
+}
+
+template<typename Real>
+void objchunk<Real>::faceEnd()
+{
+	if( _faceHasErrors )
+	{
+		flushFaceElements();
+		append( FACE_END );
+	}
+	else
+	{
+		// Runs only hold faces of consecutive lines, so face j of a run is on line + j
+		const command* last = _commands.empty() ? 0 : &_commands.back();
+		if( last && last->type == FACES && last->line + last->count == _lineNumber )
+			++_commands.back().count;
+		else
+			append( FACES );
+
+		_faceSizes.push_back( _faceSize );
+	}
+
+	_inFace = false;
+}
+
+template<typename Real>
+void objchunk<Real>::objectName( const char* name, const char* nameEnd )
+{
+	appendString( OBJECT_NAME, name, nameEnd );
+}
+
+template<typename Real>
+void objchunk<Real>::groupName( const char* name, const char* nameEnd )
+{
+	appendString( GROUP_NAME, name, nameEnd );
+}
+
+template<typename Real>
+void objchunk<Real>::materialLib( const std::string& filename )
+{
+	appendString( MATERIAL_LIB, filename );
+}
+
+template<typename Real>
+void objchunk<Real>::materialUse( const char* name, const char* nameEnd )
+{
+	appendString( MATERIAL_USE, name, nameEnd );
+}
+
+template<typename Real>
+void objchunk<Real>::smoothingGroup( unsigned int group )
+{
+	append( SMOOTHING_GROUP, group );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void objchunk<Real>::sendFaces( const view& v, basic_objparser<Real>& parser, size_t& face, size_t& element, unsigned int count )
+{
+	basic_batchsink<Real>* sink = parser.batchSink;
+	const size_t blockSize = ( parser.batchSize > 0 ) ? parser.batchSize : 1;
+
+	if( parser.triangulate )
+	{
+		if( sink )
+		{
+			parser.sendTriangles( v.faceSizes + face, count, v.faceElements + element );
+
+			for( unsigned int j = 0; j < count; ++j )
+				element += v.faceSizes[face++];
+		}
+		else
+		{
+			for( unsigned int j = 0; j < count; ++j )
+			{
+				const unsigned int size = v.faceSizes[face++];
+				parser.sendFace( v.faceElements + element, size );
+				element += size;
+			}
+		}
+	}
+	else if( sink )
+	{
+		for( unsigned int j = 0; j < count; )
+		{
+			const unsigned int numFaces = (unsigned int)std::min( (size_t)( count - j ), blockSize );
+
+			size_t numElements = 0;
+			for( unsigned int k = 0; k < numFaces; ++k )
+				numElements += v.faceSizes[face + k];
+
+			sink->faces( v.faceSizes + face, numFaces, v.faceElements + element, numElements );
+
+			j += numFaces;
+			face += numFaces;
+			element += numElements;
+		}
+	}
+	else
+	{
+		for( unsigned int j = 0; j < count; ++j )
+		{
+			unsigned int size = v.faceSizes[face++];
+
+			parser.faceBeginSignal.send( size );
+			for( unsigned int k = 0; k < size; ++k )
+				parser.faceElementSignal.send( v.faceElements[element++] );
+			parser.faceEndSignal.send();
+		}
+	}
+}
+
+template<typename Real>
+void objchunk<Real>::append( commandtype type, unsigned int count )
+{
+	command c;
+	c.type = type;
+	c.line = _lineNumber;
+	c.count = count;
+	_commands.push_back( c );
+}
+
+template<typename Real>
+void objchunk<Real>::appendRun( commandtype type )
+{
+	if( !_commands.empty() && _commands.back().type == (unsigned int)type )
+		++_commands.back().count;
+	else
+		append( type );
+}
+
+template<typename Real>
+void objchunk<Real>::appendString( commandtype type, const char* text, const char* textEnd )
+{
+	append( type );
+	_text.insert( _text.end(), text, textEnd );
+	_textEnds.push_back( (unsigned int)_text.size() );
+}
+
+template<typename Real>
+void objchunk<Real>::flushFaceElements()
+{
+	if( _faceElements.size() > _faceFlushed )
+		append( FACE_ELEMENTS, (unsigned int)( _faceElements.size() - _faceFlushed ) );
+
+	_faceFlushed = _faceElements.size();
+}
+
+namespace obj
+{
+	template class objchunk<double>;
+	template class objchunk<float>;
+}
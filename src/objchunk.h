@@ -0,0 +1,181 @@
+#ifndef _OBJ_OBJCHUNK_H_
+#define _OBJ_OBJCHUNK_H_
+
+#include <obj/types.h>
+#include <obj/parsestats.h>
+#include <obj/arena.h>
+#include <vector>
+
+namespace obj
+{
+	template<typename Real> class basic_objparser;
+
+	/*
+	 *	Parse results of a range of lines, recorded in file order.
+	 *
+	 *	Used as objreader handler by worker threads. Line numbers and
+	 *	indices converted from negative values are local to the chunk
+	 *	until applyBase() and replay() add the counts of all preceding
+	 *	chunks.
+	 */
+	template<typename Real>
+	class objchunk
+	{
+	public:
+		typedef Real real_type;
+		typedef vec3<Real> vector_type;
+
+		struct command
+		{
+			unsigned int type;
+			unsigned int line;
+			unsigned int count;
+		};
+
+		// Recorded arrays, either owned by a chunk or mapped from a cache file
+		struct view
+		{
+			const command* commands;
+			size_t numCommands;
+			const vector_type* vertices;
+			size_t numVertices;
+			const real_type* weights;
+			size_t numWeights;
+			const vector_type* colors;
+			size_t numColors;
+			const vector_type* normals;
+			size_t numNormals;
+			const vector_type* texcoords;
+			size_t numTexCoords;
+			const vector_type* parameters;
+			size_t numParameters;
+			const unsigned int* faceSizes;
+			size_t numFaces;
+			const face_index* faceElements;
+			size_t numFaceElements;
+
+			// String i is [text + textEnds[i - 1], text + textEnds[i])
+			const unsigned int* textEnds;
+			size_t numStrings;
+			const char* text;
+			size_t textSize;
+
+			// Check that commands only refer to elements inside the arrays
+			bool isValid() const;
+		};
+
+		// Recorded arrays are allocated from memory if set
+		objchunk( arena* memory = 0 );
+
+		// Prepare for a new range of lines, keeps allocated memory
+		void clear( bool convertNegativeIndices );
+
+		// Clear, then parse lines [begin, end) into chunk, profiling them in stats() if requested
+		void record( const char* begin, const char* end, bool convertNegativeIndices, bool profile );
+
+		// Add counts of preceding chunks to indices converted from negative values
+		void applyBase( int numVertices, int numTexCoords, int numNormals );
+
+		// Send recorded elements through parser signals, or its batch sink if set
+		void replay( basic_objparser<Real>& parser, unsigned int baseLine ) const;
+		static void replay( const view& v, basic_objparser<Real>& parser, unsigned int baseLine );
+
+		view getView() const;
+
+		unsigned int numLines() const { return _lineNumber; }
+		int numVertices() const { return _numVertices; }
+		int numNormals() const { return _numNormals; }
+		int numTexCoords() const { return _numTexCoords; }
+
+		// Filled by a profiling objreader
+		objstats& stats() { return _stats; }
+
+		/************************************************************************/
+		/* objreader handler                                                    */
+		/************************************************************************/
+
+		void nextLine();
+		void error( const std::string& message );
+		void comment( const std::string& text );
+		void vertex( const vector_type& v );
+		void weightedVertex( const vector_type& v, real_type w );
+		void coloredVertex( const vector_type& v, const vector_type& color );
+		void normal( const vector_type& n );
+		void texcoord( const vector_type& t );
+		void parameter( const vector_type& p );
+		void faceBegin( unsigned int numElements );
+		void faceElement( face_index& idx );
+		void faceEnd();
+		void objectName( const char* name, const char* nameEnd );
+		void groupName( const char* name, const char* nameEnd );
+		void materialLib( const std::string& filename );
+		void materialUse( const char* name, const char* nameEnd );
+		void smoothingGroup( unsigned int group );
+
+	private:
+		enum commandtype
+		{
+			VERTICES,			// run of vertices
+			WEIGHTED_VERTICES,	// run of vertices with weights
+			COLORED_VERTICES,	// run of vertices with colors
+			NORMALS,			// run of normals
+			TEXCOORDS,			// run of texcoords
+			PARAMETERS,			// run of parameter space vertices
+			FACES,				// run of faces without element errors on consecutive lines
+			FACE_BEGIN,			// face with element errors, count = number of elements
+			FACE_ELEMENTS,		// run of elements of current face
+			FACE_END,
+			SMOOTHING_GROUP,	// count = group
+			ERROR_MESSAGE,
+			COMMENT,
+			OBJECT_NAME,
+			GROUP_NAME,
+			MATERIAL_LIB,
+			MATERIAL_USE
+		};
+
+		void append( commandtype type, unsigned int count = 1 );
+		void appendRun( commandtype type );
+		void appendString( commandtype type, const char* text, const char* textEnd );
+		void appendString( commandtype type, const std::string& text ) { appendString( type, text.data(), text.data() + text.size() ); }
+		void flushFaceElements();
+
+		// Run of count faces starting at face and element, both advanced past it
+		static void sendFaces( const view& v, basic_objparser<Real>& parser, size_t& face, size_t& element, unsigned int count );
+
+		bool _convertNegativeIndices;
+		unsigned int _lineNumber;
+		int _numVertices;
+		int _numNormals;
+		int _numTexCoords;
+
+		// Current face
+		unsigned int _faceSize;
+		size_t _faceFlushed;
+		bool _faceHasErrors;
+		bool _inFace;
+
+		std::vector< command, arenaallocator<command> > _commands;
+		std::vector< vector_type, arenaallocator<vector_type> > _vertices;
+		std::vector< vector_type, arenaallocator<vector_type> > _normals;
+		std::vector< vector_type, arenaallocator<vector_type> > _texcoords;
+		std::vector< vector_type, arenaallocator<vector_type> > _parameters;
+
+		// One per vertex of WEIGHTED_VERTICES and COLORED_VERTICES runs
+		std::vector< real_type, arenaallocator<real_type> > _weights;
+		std::vector< vector_type, arenaallocator<vector_type> > _colors;
+		std::vector< unsigned int, arenaallocator<unsigned int> > _faceSizes;
+		std::vector< face_index, arenaallocator<face_index> > _faceElements;
+
+		// Strings stored back to back, see view::textEnds
+		std::vector< char, arenaallocator<char> > _text;
+		std::vector< unsigned int, arenaallocator<unsigned int> > _textEnds;
+
+		// Face element components converted from negative indices: element * 3 + component
+		std::vector< unsigned int, arenaallocator<unsigned int> > _fixups;
+
+		objstats _stats;
+	};
+}
+
+#endif // _OBJ_OBJCHUNK_H_
@@ -0,0 +1,515 @@
+#include <obj/objindex.h>
+#include <obj/objparser.h>
+#include "mappedfile.h"
+#include "objreader.h"
+#include "scanner.h"
+#include "thread.h"
+#include "decompressor.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace obj;
+
+namespace
+{
+	const char MAGIC[8] = { 'O', 'B', 'J', 'I', 'N', 'D', 'E', 'X' };
+
+	// Increment whenever the layout below changes
+	const unsigned long long VERSION = 1;
+
+	// Lines indexed by one worker at a time
+	const size_t INDEX_CHUNK_SIZE = 4 << 20;
+
+	const unsigned int NONE = 0xffffffff;
+
+	// Followed by entries, then their names back to back
+	struct fileheader
+	{
+		char magic[8];
+		unsigned long long version;
+		unsigned long long fileSize;
+		long long fileTime;
+		unsigned long long numEntries;
+		unsigned long long textSize;
+	};
+
+	struct fileentry
+	{
+		unsigned long long offset;
+		unsigned int type;
+		unsigned int line;
+		int numVertices;
+		int numTexCoords;
+		int numNormals;
+		unsigned int nameSize;
+	};
+
+	bool identify( const char* filename, unsigned long long& size, long long& time )
+	{
+#ifdef _WIN32
+		struct _stat64 st;
+		if( _stat64( filename, &st ) != 0 )
+			return false;
+#else
+		struct stat st;
+		if( stat( filename, &st ) != 0 )
+			return false;
+#endif
+
+		size = (unsigned long long)st.st_size;
+		time = (long long)st.st_mtime;
+		return true;
+	}
+
+	// objreader handler counting attributes and recording names of one chunk
+	class indexer
+	{
+	public:
+		typedef double real_type;
+		typedef vec3d vector_type;
+
+		indexer( const char* data )
+			: numLines( 0 ), numVertices( 0 ), numTexCoords( 0 ), numNormals( 0 ), _data( data ), _line( 0 )
+		{
+			// empty
+		}
+
+		void index( const char* begin, const char* end )
+		{
+			objreader<indexer> reader( *this );
+			scanner::linesplitter lines( begin, end );
+			const char* line;
+			const char* lineEnd;
+
+			while( lines.next( line, lineEnd ) )
+			{
+				++numLines;
+
+				// Only lines changing counts or starting sections go through the reader
+				const char* p = scanner::skipSpace( line, lineEnd );
+				if( p == lineEnd || ( *p != 'v' && *p != 'o' && *p != 'g' && *p != 'u' && *p != 'm' ) )
+					continue;
+
+				_line = line;
+				reader.parseLine( line, scanner::trimLineBreak( line, lineEnd, end ) );
+			}
+		}
+
+		std::vector<objindex::entry> entries;
+		unsigned int numLines;
+		int numVertices;
+		int numTexCoords;
+		int numNormals;
+
+		// objreader handler
+		void nextLine() {}
+		void error( const std::string& /*message*/ ) {}
+		void comment( const std::string& /*text*/ ) {}
+		void vertex( const vector_type& /*v*/ ) { ++numVertices; }
+		void weightedVertex( const vector_type& /*v*/, real_type /*w*/ ) { ++numVertices; }
+		void coloredVertex( const vector_type& /*v*/, const vector_type& /*color*/ ) { ++numVertices; }
+		void normal( const vector_type& /*n*/ ) { ++numNormals; }
+		void texcoord( const vector_type& /*t*/ ) { ++numTexCoords; }
+		void parameter( const vector_type& /*p*/ ) {}
+		void faceBegin( unsigned int /*numElements*/ ) {}
+		void faceElement( face_index& /*idx*/ ) {}
+		void faceEnd() {}
+		void objectName( const char* name, const char* nameEnd ) { add( objindex::OBJECT_NAME, name, nameEnd ); }
+		void groupName( const char* name, const char* nameEnd ) { add( objindex::GROUP_NAME, name, nameEnd ); }
+		void materialLib( const std::string& filename ) { add( objindex::MATERIAL_LIB, filename.data(), filename.data() + filename.size() ); }
+		void materialUse( const char* name, const char* nameEnd ) { add( objindex::MATERIAL_USE, name, nameEnd ); }
+		void smoothingGroup( unsigned int /*group*/ ) {}
+
+	private:
+		// Counts relative to chunk until merged
+		void add( objindex::keyword type, const char* name, const char* nameEnd )
+		{
+			objindex::entry e;
+			e.type = type;
+			e.name.assign( name, nameEnd );
+			e.offset = _line - _data;
+			e.line = numLines - 1;
+			e.numVertices = numVertices;
+			e.numTexCoords = numTexCoords;
+			e.numNormals = numNormals;
+			entries.push_back( e );
+		}
+
+		const char* _data;
+		const char* _line;
+	};
+
+	// Shared state of a parallel indexing pass
+	struct indexpass
+	{
+		const char* data;
+		std::vector<const char*> bounds;
+		std::vector<indexer*> chunks;
+		unsigned int nextChunk;
+		mutex guard;
+	};
+
+	void indexChunks( void* arg )
+	{
+		indexpass& pass = *(indexpass*)arg;
+
+		while( true )
+		{
+			unsigned int i;
+			{
+				scoped_lock lock( pass.guard );
+				if( pass.nextChunk == pass.chunks.size() )
+					return;
+
+				i = pass.nextChunk++;
+			}
+
+			pass.chunks[i]->index( pass.bounds[i], pass.bounds[i + 1] );
+		}
+	}
+
+	// Lines [begin, end) of the line starting at offset
+	void lineAt( const mappedfile& file, unsigned long long offset, const char*& begin, const char*& end )
+	{
+		const char* fileEnd = file.data() + file.size();
+		begin = file.data() + offset;
+
+		const char* lineEnd = scanner::findLineEnd( begin, fileEnd );
+		end = ( lineEnd != fileEnd ) ? lineEnd + 1 : fileEnd;
+	}
+}
+
+objindex::objindex()
+	: _fileSize( 0 ), _fileTime( 0 )
+{
+	// empty
+}
+
+bool objindex::build( const char* filename, unsigned int numThreads )
+{
+	_filename = filename;
+	_entries.clear();
+
+	mappedfile file;
+	if( !identify( filename, _fileSize, _fileTime ) || !file.open( filename ) )
+		return false;
+
+	// Byte offsets of compressed data mean nothing to the parser
+	if( decompressor::detect( file.data(), file.size() ) != decompressor::NONE )
+		return false;
+
+	indexpass pass;
+	pass.data = file.data();
+	pass.nextChunk = 0;
+
+	// Split at line breaks
+	const char* end = file.data() + file.size();
+	pass.bounds.push_back( file.data() );
+	for( const char* p = file.data(); p != end; pass.bounds.push_back( p ) )
+	{
+		if( (size_t)( end - p ) <= INDEX_CHUNK_SIZE )
+		{
+			p = end;
+			continue;
+		}
+
+		p = scanner::findLineEnd( p + INDEX_CHUNK_SIZE, end );
+		p = ( p != end ) ? p + 1 : end;
+	}
+
+	for( size_t i = 0; i + 1 < pass.bounds.size(); ++i )
+		pass.chunks.push_back( new indexer( file.data() ) );
+
+	const unsigned int workers = std::min( ( numThreads == 0 ) ? thread::hardwareConcurrency() : numThreads, (unsigned int)pass.chunks.size() );
+
+	// Calling thread works too
+	std::vector<thread*> threads;
+	for( unsigned int i = 1; i < workers; ++i )
+	{
+		thread* t = new thread();
+		if( t->start( indexChunks, &pass ) )
+			threads.push_back( t );
+		else
+			delete t;
+	}
+
+	indexChunks( &pass );
+
+	for( size_t i = 0; i < threads.size(); ++i )
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	// Add counts of preceding chunks
+	unsigned int numLines = 0;
+	int numVertices = 0;
+	int numTexCoords = 0;
+	int numNormals = 0;
+
+	for( size_t i = 0; i < pass.chunks.size(); ++i )
+	{
+		indexer& c = *pass.chunks[i];
+
+		for( size_t j = 0; j < c.entries.size(); ++j )
+		{
+			entry& e = c.entries[j];
+			e.line += numLines;
+			e.numVertices += numVertices;
+			e.numTexCoords += numTexCoords;
+			e.numNormals += numNormals;
+			_entries.push_back( e );
+		}
+
+		numLines += c.numLines;
+		numVertices += c.numVertices;
+		numTexCoords += c.numTexCoords;
+		numNormals += c.numNormals;
+
+		delete pass.chunks[i];
+	}
+
+	return true;
+}
+
+bool objindex::open( const char* filename, unsigned int numThreads )
+{
+	if( load( filename ) )
+		return true;
+
+	if( !build( filename, numThreads ) )
+		return false;
+
+	// Index is usable even if it could not be written
+	save();
+	return true;
+}
+
+bool objindex::load( const char* filename )
+{
+	_filename = filename;
+	_entries.clear();
+
+	if( !identify( filename, _fileSize, _fileTime ) )
+		return false;
+
+	std::ifstream file( sidecarFile( filename ).c_str(), std::ios::binary );
+
+	fileheader header;
+	if( !file.read( (char*)&header, sizeof( header ) ) )
+		return false;
+
+	if( memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.version != VERSION ||
+		header.fileSize != _fileSize || header.fileTime != _fileTime )
+		return false;
+
+	std::vector<fileentry> entries( (size_t)header.numEntries );
+	std::vector<char> text( (size_t)header.textSize );
+
+	if( !entries.empty() && !file.read( (char*)&entries[0], (std::streamsize)( entries.size() * sizeof( fileentry ) ) ) )
+		return false;
+
+	if( !text.empty() && !file.read( &text[0], (std::streamsize)text.size() ) )
+		return false;
+
+	size_t position = 0;
+	_entries.resize( entries.size() );
+
+	for( size_t i = 0; i < entries.size(); ++i )
+	{
+		const fileentry& f = entries[i];
+
+		if( f.nameSize > text.size() - position || f.type > MATERIAL_LIB || f.offset >= _fileSize )
+		{
+			_entries.clear();
+			return false;
+		}
+
+		entry& e = _entries[i];
+		e.type = (keyword)f.type;
+		e.name.assign( text.begin() + position, text.begin() + position + f.nameSize );
+		e.offset = f.offset;
+		e.line = f.line;
+		e.numVertices = f.numVertices;
+		e.numTexCoords = f.numTexCoords;
+		e.numNormals = f.numNormals;
+
+		position += f.nameSize;
+	}
+
+	return true;
+}
+
+bool objindex::save() const
+{
+	std::vector<fileentry> entries( _entries.size() );
+	std::string text;
+
+	for( size_t i = 0; i < _entries.size(); ++i )
+	{
+		const entry& e = _entries[i];
+
+		fileentry& f = entries[i];
+		f.offset = e.offset;
+		f.type = e.type;
+		f.line = e.line;
+		f.numVertices = e.numVertices;
+		f.numTexCoords = e.numTexCoords;
+		f.numNormals = e.numNormals;
+		f.nameSize = (unsigned int)e.name.size();
+
+		text += e.name;
+	}
+
+	fileheader header;
+	memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+	header.version = VERSION;
+	header.fileSize = _fileSize;
+	header.fileTime = _fileTime;
+	header.numEntries = entries.size();
+	header.textSize = text.size();
+
+	std::ofstream file( sidecarFile( _filename.c_str() ).c_str(), std::ios::binary | std::ios::trunc );
+	file.write( (const char*)&header, sizeof( header ) );
+
+	if( !entries.empty() )
+		file.write( (const char*)&entries[0], (std::streamsize)( entries.size() * sizeof( fileentry ) ) );
+
+	file.write( text.data(), (std::streamsize)text.size() );
+	file.close();
+
+	return !file.fail();
+}
+
+std::string objindex::sidecarFile( const char* filename )
+{
+	return std::string( filename ) + ".idx";
+}
+
+void objindex::findObject( const std::string& name, std::vector<range>& ranges ) const
+{
+	find( OBJECT_NAME, name, ranges );
+}
+
+void objindex::findGroup( const std::string& name, std::vector<range>& ranges ) const
+{
+	find( GROUP_NAME, name, ranges );
+}
+
+void objindex::findMaterial( const std::string& name, std::vector<range>& ranges ) const
+{
+	find( MATERIAL_USE, name, ranges );
+}
+
+template<typename Real>
+bool objindex::parse( basic_objparser<Real>& parser, const std::vector<range>& ranges ) const
+{
+	mappedfile file;
+	if( !file.open( _filename.c_str() ) || file.size() != _fileSize )
+		return false;
+
+	parser.reset();
+
+	// Last o, g and usemtl entries sent, and mtllib entries sent
+	unsigned int current[MATERIAL_LIB] = { NONE, NONE, NONE };
+	std::vector<bool> libSent( _entries.size(), false );
+
+	for( size_t r = 0; r < ranges.size(); ++r )
+	{
+		const range& rg = ranges[r];
+		if( rg.entry >= _entries.size() || rg.end > _fileSize )
+			continue;
+
+		const entry& first = _entries[rg.entry];
+
+		// Context of range, in file order
+		unsigned int last[MATERIAL_LIB] = { NONE, NONE, NONE };
+		std::vector<unsigned int> context;
+
+		for( unsigned int i = 0; i < rg.entry; ++i )
+		{
+			if( _entries[i].type != MATERIAL_LIB )
+				last[_entries[i].type] = i;
+			else if( !libSent[i] )
+				context.push_back( i );
+		}
+
+		for( int k = 0; k < MATERIAL_LIB; ++k )
+			if( last[k] != NONE && last[k] != current[k] )
+				context.push_back( last[k] );
+
+		std::sort( context.begin(), context.end() );
+
+		for( size_t i = 0; i < context.size(); ++i )
+		{
+			const entry& e = _entries[context[i]];
+
+			const char* begin;
+			const char* end;
+			lineAt( file, e.offset, begin, end );
+			parser.parseSection( begin, end, e.line, e.numVertices, e.numTexCoords, e.numNormals );
+
+			if( e.type == MATERIAL_LIB )
+				libSent[context[i]] = true;
+			else
+				current[e.type] = context[i];
+		}
+
+		parser.parseSection( file.data() + first.offset, file.data() + rg.end, first.line, first.numVertices, first.numTexCoords, first.numNormals );
+
+		// Sections started inside range
+		for( unsigned int i = rg.entry; i < _entries.size() && _entries[i].offset < rg.end; ++i )
+		{
+			if( _entries[i].type == MATERIAL_LIB )
+				libSent[i] = true;
+			else
+				current[_entries[i].type] = i;
+		}
+	}
+
+	parser.endParse();
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+void objindex::find( keyword type, const std::string& name, std::vector<range>& ranges ) const
+{
+	// Types ending a section of each type
+	static const bool objectEnds[] = { true, false, false, false };
+	static const bool groupEnds[] = { true, true, false, false };
+	static const bool materialEnds[] = { true, true, true, false };
+
+	const bool* ends = ( type == OBJECT_NAME ) ? objectEnds : ( type == GROUP_NAME ) ? groupEnds : materialEnds;
+
+	for( size_t i = 0; i < _entries.size(); ++i )
+	{
+		if( _entries[i].type != type || _entries[i].name != name )
+			continue;
+
+		range r;
+		r.entry = (unsigned int)i;
+		r.end = sectionEnd( i, ends );
+		ranges.push_back( r );
+	}
+}
+
+unsigned long long objindex::sectionEnd( size_t i, const bool* types ) const
+{
+	for( ++i; i < _entries.size(); ++i )
+		if( types[_entries[i].type] )
+			return _entries[i].offset;
+
+	return _fileSize;
+}
+
+namespace obj
+{
+	template bool objindex::parse( basic_objparser<double>& parser, const std::vector<range>& ranges ) const;
+	template bool objindex::parse( basic_objparser<float>& parser, const std::vector<range>& ranges ) const;
+}
@@ -1,224 +1,489 @@
 #include <obj/objparser.h>
+#include "scanner.h"
+#include "mappedfile.h"
+#include "objreader.h"
+#include "objchunk.h"
+#include "objcache.h"
+#include "thread.h"
+#include "timer.h"
+#include "decompressor.h"
 #include <fstream>
-#include <sstream>
-#include <vector>
-#include <ctype.h>
+#include <algorithm>
 
 using namespace obj;
 
-objparser::objparser()
+// Size of line ranges parsed by each worker thread
+static const size_t PARALLEL_CHUNK_SIZE = 4 << 20;
+
+// Size of line ranges recorded at once for a batch sink or cache
+static const size_t BATCH_CHUNK_SIZE = 256 << 10;
+
+// End of line range starting at p of at least given size, or end
+static const char* chunkEnd( const char* p, const char* end, size_t size )
+{
+	if( (size_t)( end - p ) <= size )
+		return end;
+
+	p = scanner::findLineEnd( p + size, end );
+	return ( p != end ) ? p + 1 : end;
+}
+
+namespace
+{
+	// Shared state of a parallel parse
+	template<typename Real>
+	struct parallelparse
+	{
+		// Chunk i is [bounds[i], bounds[i + 1])
+		std::vector<const char*> bounds;
+
+		// Chunk i is parsed into slot i % slots.size() once the previous user of the slot was replayed
+		std::vector< objchunk<Real> > slots;
+		std::vector<bool> parsed;
+
+		unsigned int numChunks;
+		unsigned int nextChunk;
+		unsigned int numReplayed;
+		bool convertNegativeIndices;
+		bool profile;
+
+		mutex guard;
+		condition changed;
+	};
+
+	template<typename Real>
+	void parseChunks( void* arg )
+	{
+		parallelparse<Real>& state = *(parallelparse<Real>*)arg;
+		const unsigned int numSlots = (unsigned int)state.slots.size();
+
+		while( true )
+		{
+			unsigned int i;
+			{
+				scoped_lock lock( state.guard );
+
+				// Wait until the slot is free again
+				while( state.nextChunk < state.numChunks && state.nextChunk >= state.numReplayed + numSlots )
+					state.changed.wait( state.guard );
+
+				if( state.nextChunk >= state.numChunks )
+					return;
+
+				i = state.nextChunk++;
+			}
+
+			state.slots[i % numSlots].record( state.bounds[i], state.bounds[i + 1], state.convertNegativeIndices, state.profile );
+
+			scoped_lock lock( state.guard );
+			state.parsed[i % numSlots] = true;
+			state.changed.notifyAll();
+		}
+	}
+
+	void joinAll( std::vector<thread*>& threads )
+	{
+		for( size_t i = 0; i < threads.size(); ++i )
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+		threads.clear();
+	}
+}
+
+template<typename Real>
+basic_objparser<Real>::basic_objparser()
 {
 	convertNegativeIndices = true;
+	checkIndices = false;
+	numThreads = 1;
+	batchSink = 0;
+	batchSize = 4096;
+	cacheCheckContent = false;
+	stats = 0;
+	memory = 0;
+	triangulate = false;
+	_cache = 0;
+	_startTime = 0.0;
+	_feeding = false;
 }
 
-void objparser::parse( const char* filename )
+template<typename Real>
+void basic_objparser<Real>::parse( const char* filename )
 {
+	reset();
+
+	// Parse directly from mapped pages when possible
+	mappedfile mapping;
+	const double start = stats ? now() : 0.0;
+
+	if( mapping.open( filename ) )
+	{
+		if( stats )
+			stats->ioTime += now() - start;
+
+		if( !cacheDirectory.empty() )
+			parseCached( filename, mapping );
+		else if( !parseCompressed( mapping.data(), mapping.size() ) )
+			parseLines( mapping.data(), mapping.data() + mapping.size() );
+
+		endParse();
+		return;
+	}
+
 	std::ifstream file( filename );
 	if( !file )
 	{
+		if( stats )
+			++stats->numErrors[parsestats::FILE_ERROR];
+
 		errorSignal.send( 0, "Cannot open file '" + std::string( filename ) + "'." );
+		endParse();
 		return;
 	}
 
-	parse( file );
+	parseStream( file );
+	endParse();
+}
+
+template<typename Real>
+void basic_objparser<Real>::parse( std::istream& file )
+{
+	reset();
+	parseStream( file );
+	endParse();
 }
 
-void objparser::parse( std::istream& file )
+template<typename Real>
+void basic_objparser<Real>::parse( const char* data, size_t size )
+{
+	reset();
+	parseLines( data, data + size );
+	endParse();
+}
+
+template<typename Real>
+void basic_objparser<Real>::feed( const char* data, size_t size )
+{
+	if( !_feeding )
+	{
+		reset();
+		_feeding = true;
+	}
+
+	// Only time spent in here counts, not waiting for data
+	const double start = stats ? now() : 0.0;
+
+	scanner::parseBlock( data, data + size, _partialLine, *this, &basic_objparser::parseLines );
+
+	if( stats )
+		stats->totalTime += now() - start;
+}
+
+template<typename Real>
+void basic_objparser<Real>::finish()
+{
+	if( !_feeding )
+		return;
+
+	const double start = stats ? now() : 0.0;
+
+	scanner::parseLastLine( _partialLine, *this, &basic_objparser::parseLines );
+	_feeding = false;
+
+	if( stats )
+		stats->totalTime += now() - start;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void basic_objparser<Real>::reset()
 {
-	std::string line;
 	_lineNumber = 0;
 	_numVertices = 0;
 	_numNormals = 0;
 	_numTexCoords = 0;
 
-	while( std::getline( file, line ) )
+	// A full parse abandons any push parse in progress
+	_feeding = false;
+	_partialLine.clear();
+
+	_names.clear();
+	_positions.clear();
+
+	if( stats )
 	{
-		std::stringstream ss( line );
-		++_lineNumber;
+		stats->clear();
+		_startTime = now();
+	}
+}
 
-		// Read until next whitespace
-		ss.unsetf( std::ios_base::skipws );
-		ss >> std::ws;
+template<typename Real>
+void basic_objparser<Real>::endParse()
+{
+	if( stats )
+		stats->totalTime = now() - _startTime;
+}
 
-		// Check empty line
-		if( ss.eof() )
-			continue;
+template<typename Real>
+unsigned int basic_objparser<Real>::numWorkers() const
+{
+	return ( numThreads == 0 ) ? thread::hardwareConcurrency() : numThreads;
+}
 
-		// Check comment line
-		if( ss.peek() == '#' )
-		{
-			commentSignal.send( _lineNumber, line.c_str() + 2 );
-			continue;
-		}
+template<typename Real>
+void basic_objparser<Real>::parseStream( std::istream& file )
+{
+	// Read enough at once to keep all workers busy
+	const unsigned int workers = numWorkers();
+	const size_t blockSize = ( workers > 1 ) ? 2 * workers * PARALLEL_CHUNK_SIZE : scanner::STREAM_BLOCK_SIZE;
 
-		// Check keyword
-		std::string keyword;
-		ss >> keyword;
+	scanner::readStream( file, *this, &basic_objparser::parseLines, blockSize, stats ? &stats->ioTime : 0 );
+}
 
-		// Case vertex
-		if( keyword == "v" )
-		{
-			vec3d v;
-			ss >> std::ws >> v.x >> std::ws >> v.y >> std::ws >> v.z >> std::ws;
+template<typename Real>
+void basic_objparser<Real>::parseLines( const char* begin, const char* end )
+{
+	if( numWorkers() > 1 && (size_t)( end - begin ) > 2 * PARALLEL_CHUNK_SIZE )
+	{
+		parseParallel( begin, end );
+		return;
+	}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( _lineNumber, "Parse error reading vertex, skipping it." );
-				continue;
-			}
+	parseSerial( begin, end );
+}
 
-			if( !ss.eof() )
-				errorSignal.send( _lineNumber, "Ignoring information beyond third vertex value." );
+template<typename Real>
+void basic_objparser<Real>::parseSerial( const char* begin, const char* end )
+{
+	if( batchSink || _cache || stats || checkIndices )
+	{
+		parseRecorded( begin, end );
+		return;
+	}
 
-			vertexSignal.send( v );
-			++_numVertices;
-		}
-		// Case normal
-		else if( keyword == "vn" )
-		{
-			vec3d n;
-			ss >> std::ws >> n.x >> std::ws >> n.y >> std::ws >> n.z >> std::ws;
+	objreader<basic_objparser> reader( *this );
+	reader.parseLines( begin, end );
+}
 
-			if( ss.fail() )
-			{
-				errorSignal.send( _lineNumber, "Parse error reading normal, skipping it." );
-				continue;
-			}
+template<typename Real>
+void basic_objparser<Real>::parseRecorded( const char* begin, const char* end )
+{
+	arenascope scope( memory );
+	objchunk<Real> chunk( memory );
 
-			if( !ss.eof() )
-				errorSignal.send( _lineNumber, "Ignoring information beyond third normal value." );
+	while( begin != end )
+	{
+		const char* next = chunkEnd( begin, end, BATCH_CHUNK_SIZE );
 
-			normalSignal.send( n );
-			++_numNormals;
-		}
-		// Case texcoord
-		else if( keyword == "vt" )
-		{
-			vec3d t;
-			ss >> std::ws >> t.x >> std::ws;
-			
-			// Optional parameter
-			if( !ss.eof() )
-				ss >> t.y >> std::ws;
-
-			// Optional parameter
-			if( !ss.eof() )
-				ss >> t.z >> std::ws;
-
-			if( ss.fail() )
-			{
-				errorSignal.send( _lineNumber, "Parse error reading texture coordinate, skipping it." );
-				continue;
-			}
+		chunk.record( begin, next, convertNegativeIndices, stats != 0 );
+		replayChunk( chunk );
+		begin = next;
+	}
+}
 
-			if( !ss.eof() )
-				errorSignal.send( _lineNumber, "Ignoring information beyond third texcoord value." );
+template<typename Real>
+void basic_objparser<Real>::parseCached( const char* filename, const mappedfile& source )
+{
+	objcache<Real> cache( cacheDirectory, filename, convertNegativeIndices );
 
-			texcoordSignal.send( t );
-			++_numTexCoords;
+	// Replay unchanged file
+	if( cache.open( source.data(), source.size(), cacheCheckContent ) )
+	{
+		typename objchunk<Real>::view v;
+		unsigned int baseLine;
+		const double start = stats ? now() : 0.0;
+
+		while( cache.next( v, baseLine ) )
+		{
+			objchunk<Real>::replay( v, *this, baseLine );
+
+			_numVertices += (int)v.numVertices;
+			_numNormals += (int)v.numNormals;
+			_numTexCoords += (int)v.numTexCoords;
 		}
-		// Case face
-		else if( keyword == "f" || keyword == "fo" )
+
+		if( stats )
 		{
-			std::vector<std::string> elements;
+			stats->fromCache = true;
+			stats->numBytes = source.size();
+			stats->dispatchTime += now() - start;
+		}
+		return;
+	}
 
-			// Read each element as a separate string
-			while( !ss.eof() )
-			{
-				std::string elem;
-				ss >> std::ws >> elem >> std::ws;
-				elements.push_back( elem );
-			}
+	// Parse and record chunks as they are replayed, cache is only kept if complete
+	if( cache.create( source.data(), source.size() ) )
+		_cache = &cache;
 
-			if( ss.fail() || elements.empty() )
-			{
-				errorSignal.send( _lineNumber, "Parse error reading face list, skipping it." );
-				continue;
-			}
+	try
+	{
+		if( !parseCompressed( source.data(), source.size() ) )
+			parseLines( source.data(), source.data() + source.size() );
+	}
+	catch( ... )
+	{
+		_cache = 0;
+		throw;
+	}
 
-			// Begin face
-			faceBeginSignal.send( (unsigned int)elements.size() );
+	// Cache was dropped if source could not be read completely
+	const bool complete = ( _cache == &cache );
+	_cache = 0;
 
-			for( unsigned int i	= 0; i < elements.size(); ++i )
-			{
-				face_index idx;
+	if( complete )
+		cache.commit();
+}
 
-				// Parse indices from nth element
-				bool ok = parseIndexTuple( idx, elements[i] );
+template<typename Real>
+bool basic_objparser<Real>::parseCompressed( const char* data, size_t size )
+{
+	const decompressor::format format = decompressor::detect( data, size );
+	if( format == decompressor::NONE )
+		return false;
 
-				if( ok )
-					faceElementSignal.send( idx );
-			}
+	// Do not cache contents that could not be read completely
+	if( !decompressor::isSupported( format ) )
+	{
+		_cache = 0;
 
-			// End face
-			faceEndSignal.send();
-		}
-		// Case object name
-		else if( keyword == "o" )
-		{
-			objectNameSignal.send( line.c_str() + 2 );
-		}
-		// Case group name
-		else if( keyword == "g" )
-		{
-			groupNameSignal.send( line.c_str() + 2 );
-		}
-		// Case material filename
-		else if( keyword == "mtllib" )
-		{
-			std::string filename;
+		if( stats )
+			++stats->numErrors[parsestats::UNSUPPORTED_ERROR];
 
-			ss.setf( std::ios_base::skipws );
+		errorSignal.send( 0, std::string( "Cannot read " ) + decompressor::name( format ) + " compressed file, support not built in." );
+		return true;
+	}
 
-			while( !ss.eof() )
-			{
-				std::string s;
-				ss >> s;
-				filename += s + " ";
-			}
+	// Decompress blocks large enough to keep all workers busy
+	const unsigned int workers = numWorkers();
+	const size_t blockSize = ( workers > 1 ) ? 2 * workers * PARALLEL_CHUNK_SIZE : scanner::STREAM_BLOCK_SIZE;
 
-			//ss >> std::ws >> filename >> std::ws;
+	decompressor input( data, size, format, blockSize );
+	if( !input.readLines( *this, &basic_objparser::parseLines, stats ? &stats->ioTime : 0 ) )
+	{
+		_cache = 0;
 
-			if( ss.fail() )
-			{
-				errorSignal.send( _lineNumber, "Parse error reading material library filename, skipping it." );
-				continue;
-			}
+		if( stats )
+			++stats->numErrors[parsestats::FILE_ERROR];
 
-			if( !ss.eof() )
-				errorSignal.send( _lineNumber, "Ignoring information beyond first material library filename." );
+		errorSignal.send( _lineNumber, "Error decompressing file: " + input.error() + "." );
+	}
 
-			materialLibSignal.send( filename );
-		}
-		// Case material use
-		else if( keyword == "usemtl" )
-		{
-			std::string material;
-			ss >> std::ws >> material >> std::ws;
+	return true;
+}
+
+template<typename Real>
+void basic_objparser<Real>::parseSection( const char* begin, const char* end, unsigned int line, int numVertices, int numTexCoords, int numNormals )
+{
+	_lineNumber = line;
+	_numVertices = numVertices;
+	_numTexCoords = numTexCoords;
+	_numNormals = numNormals;
+
+	parseLines( begin, end );
+}
 
-			if( ss.fail() )
+template<typename Real>
+void basic_objparser<Real>::replayChunk( objchunk<Real>& chunk )
+{
+	chunk.applyBase( _numVertices, _numTexCoords, _numNormals );
+
+	if( _cache )
+		_cache->write( chunk, _lineNumber );
+
+	const double start = stats ? now() : 0.0;
+	chunk.replay( *this, _lineNumber );
+
+	if( stats )
+	{
+		stats->dispatchTime += now() - start;
+		stats->merge( chunk.stats() );
+	}
+
+	_lineNumber += chunk.numLines();
+	_numVertices += chunk.numVertices();
+	_numNormals += chunk.numNormals();
+	_numTexCoords += chunk.numTexCoords();
+}
+
+template<typename Real>
+void basic_objparser<Real>::parseParallel( const char* begin, const char* end )
+{
+	parallelparse<Real> state;
+
+	// Split at line breaks
+	state.bounds.push_back( begin );
+	for( const char* p = begin; p != end; state.bounds.push_back( p ) )
+		p = chunkEnd( p, end, PARALLEL_CHUNK_SIZE );
+
+	const unsigned int workers = numWorkers();
+
+	state.numChunks = (unsigned int)state.bounds.size() - 1;
+	state.nextChunk = 0;
+	state.numReplayed = 0;
+	state.convertNegativeIndices = convertNegativeIndices;
+	state.profile = ( stats != 0 );
+	state.slots.resize( std::min( state.numChunks, 2 * workers ) );
+	state.parsed.assign( state.slots.size(), false );
+
+	std::vector<thread*> threads;
+	for( unsigned int i = 0; i < workers; ++i )
+	{
+		thread* t = new thread();
+		if( t->start( parseChunks<Real>, &state ) )
+			threads.push_back( t );
+		else
+			delete t;
+	}
+
+	// Nothing sent yet, parse on this thread instead
+	if( threads.empty() )
+	{
+		parseSerial( begin, end );
+		return;
+	}
+
+	try
+	{
+		// Replay in file order, counts of all preceding chunks are the running totals
+		for( unsigned int i = 0; i < state.numChunks; ++i )
+		{
+			const unsigned int slot = i % (unsigned int)state.slots.size();
 			{
-				errorSignal.send( _lineNumber, "Parse error reading material name, skipping it." );
-				continue;
+				scoped_lock lock( state.guard );
+				while( !state.parsed[slot] )
+					state.changed.wait( state.guard );
 			}
 
-			if( !ss.eof() )
-				errorSignal.send( _lineNumber, "Ignoring information beyond first material name." );
+			replayChunk( state.slots[slot] );
 
-			materialUseSignal.send( material );
+			scoped_lock lock( state.guard );
+			state.parsed[slot] = false;
+			++state.numReplayed;
+			state.changed.notifyAll();
 		}
-		// Case unknown
-		else
+	}
+	catch( ... )
+	{
+		// Exception from a slot, stop workers before leaving
 		{
-			errorSignal.send( _lineNumber, "Unknown keyword '" + keyword + "', skipping line." );
+			scoped_lock lock( state.guard );
+			state.nextChunk = state.numChunks;
+			state.changed.notifyAll();
 		}
+
+		joinAll( threads );
+		throw;
 	}
+
+	joinAll( threads );
 }
 
-//////////////////////////////////////////////////////////////////////////
-// Private
-//////////////////////////////////////////////////////////////////////////
-void objparser::convertNegativeIndex( face_index& idx )
+template<typename Real>
+void basic_objparser<Real>::convertNegativeIndex( face_index& idx )
 {
 	if( idx.vertexIdx < 0 )
 		idx.vertexIdx += _numVertices + 1;
@@ -230,43 +495,298 @@ void objparser::convertNegativeIndex( face_index& idx )
 		idx.texCoordIdx += _numTexCoords + 1;
 }
 
-bool objparser::parseIndexTuple( face_index& idx, const std::string& elem )
+template<typename Real>
+bool basic_objparser<Real>::isInRange( const face_index* elements, unsigned int size, size_t numVertices, size_t numTexCoords, size_t numNormals ) const
 {
-	std::stringstream elemSS( elem );
+	numVertices += _numVertices;
+	numTexCoords += _numTexCoords;
+	numNormals += _numNormals;
 
-	// Possible cases: v, v/t, v//n, v/t/n
-	elemSS >> idx.vertexIdx;
+	// Zero texcoord and normal indices are not defined in file
+	for( unsigned int i = 0; i < size; ++i )
+	{
+		const face_index& idx = elements[i];
 
-	// Check for t and n indices
-	if( !elemSS.eof() && elemSS.peek() == '/' )
+		if( idx.vertexIdx < 1 || (size_t)idx.vertexIdx > numVertices ||
+			idx.texCoordIdx < 0 || (size_t)idx.texCoordIdx > numTexCoords ||
+			idx.normalIdx < 0 || (size_t)idx.normalIdx > numNormals )
+			return false;
+	}
+
+	return true;
+}
+
+template<typename Real>
+void basic_objparser<Real>::rangeError( unsigned int line )
+{
+	if( stats )
+		++stats->numErrors[parsestats::MALFORMED_ERROR];
+
+	errorSignal.send( line, "Face index out of range, skipping face." );
+}
+
+template<typename Real>
+void basic_objparser<Real>::addPositions( const vector_type* v, size_t count )
+{
+	_positions.insert( _positions.end(), v, v + count );
+}
+
+template<typename Real>
+void basic_objparser<Real>::splitFace( const face_index* elements, unsigned int size )
+{
+	const int numPositions = (int)_positions.size();
+	_corners.resize( size );
+
+	for( unsigned int i = 0; i < size; ++i )
 	{
-		char slash1;
-		elemSS >> slash1;
+		int idx = elements[i].vertexIdx;
+		if( idx < 0 )
+			idx += numPositions + 1;
 
-		if( !elemSS.eof() && isdigit( elemSS.peek() ) )
+		// Position not known
+		if( idx < 1 || idx > numPositions )
 		{
-			// We have at least v/t
-			elemSS >> idx.texCoordIdx;
+			_triangulator.fan( size );
+			return;
 		}
 
-		// Case v//n or v/t/n
-		if( !elemSS.eof() && elemSS.peek() == '/' )
-		{
-			char slash2;
-			elemSS >> slash2 >> idx.normalIdx;
-		}
+		_corners[i] = _positions[idx - 1];
 	}
 
-	// Check for errors
-	if( elemSS.fail() || !elemSS.eof() )
+	if( !_triangulator.triangulate( &_corners[0], size ) && stats )
+		++stats->numClippedFaces;
+}
+
+template<typename Real>
+void basic_objparser<Real>::sendFace( const face_index* elements, unsigned int size )
+{
+	// Triangles and smaller faces as they are
+	if( size <= 3 )
 	{
-		errorSignal.send( _lineNumber, "Parse error reading face element, skipping it." );
-		return false;
+		faceBeginSignal.send( size );
+		for( unsigned int i = 0; i < size; ++i )
+			faceElementSignal.send( elements[i] );
+		faceEndSignal.send();
+		return;
+	}
+
+	splitFace( elements, size );
+
+	const std::vector<unsigned int>& triangles = _triangulator.triangles();
+	for( size_t i = 0; i < triangles.size(); i += 3 )
+	{
+		faceBeginSignal.send( 3 );
+		faceElementSignal.send( elements[triangles[i]] );
+		faceElementSignal.send( elements[triangles[i + 1]] );
+		faceElementSignal.send( elements[triangles[i + 2]] );
+		faceEndSignal.send();
+	}
+}
+
+template<typename Real>
+void basic_objparser<Real>::sendTriangles( const unsigned int* sizes, size_t numFaces, const face_index* elements )
+{
+	const size_t blockSize = ( batchSize > 0 ) ? batchSize : 1;
+
+	_triangleSizes.clear();
+	_triangleElements.clear();
+
+	for( size_t i = 0; i < numFaces; ++i )
+	{
+		const unsigned int size = sizes[i];
+
+		if( size <= 3 )
+		{
+			_triangleSizes.push_back( size );
+			_triangleElements.insert( _triangleElements.end(), elements, elements + size );
+		}
+		else
+		{
+			splitFace( elements, size );
+
+			const std::vector<unsigned int>& triangles = _triangulator.triangles();
+			for( size_t j = 0; j < triangles.size(); ++j )
+				_triangleElements.push_back( elements[triangles[j]] );
+
+			_triangleSizes.insert( _triangleSizes.end(), triangles.size() / 3, 3 );
+		}
+
+		elements += size;
+
+		// Full blocks as soon as they are complete, the rest after the last face
+		const bool last = ( i + 1 == numFaces );
+		if( _triangleSizes.size() < blockSize && !last )
+			continue;
+
+		size_t face = 0;
+		size_t element = 0;
+
+		while( face < _triangleSizes.size() && ( last || _triangleSizes.size() - face >= blockSize ) )
+		{
+			const size_t count = std::min( _triangleSizes.size() - face, blockSize );
+
+			size_t numElements = 0;
+			for( size_t k = 0; k < count; ++k )
+				numElements += _triangleSizes[face + k];
+
+			const face_index* e = _triangleElements.empty() ? 0 : &_triangleElements[0] + element;
+			batchSink->faces( &_triangleSizes[face], count, e, numElements );
+
+			face += count;
+			element += numElements;
+		}
+
+		_triangleSizes.erase( _triangleSizes.begin(), _triangleSizes.begin() + face );
+		_triangleElements.erase( _triangleElements.begin(), _triangleElements.begin() + element );
 	}
+}
 
+//////////////////////////////////////////////////////////////////////////
+// objreader handler
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void basic_objparser<Real>::nextLine()
+{
+	++_lineNumber;
+}
+
+template<typename Real>
+void basic_objparser<Real>::error( const std::string& message )
+{
+	errorSignal.send( _lineNumber, message );
+}
+
+template<typename Real>
+void basic_objparser<Real>::comment( const std::string& text )
+{
+	commentSignal.send( _lineNumber, text );
+}
+
+template<typename Real>
+void basic_objparser<Real>::vertex( const vector_type& v )
+{
+	if( triangulate )
+		_positions.push_back( v );
+
+	vertexSignal.send( v );
+	++_numVertices;
+}
+
+template<typename Real>
+void basic_objparser<Real>::weightedVertex( const vector_type& v, Real w )
+{
+	if( triangulate )
+		_positions.push_back( v );
+
+	vertexSignal.send( v );
+	vertexWeightSignal.send( w );
+	++_numVertices;
+}
+
+template<typename Real>
+void basic_objparser<Real>::coloredVertex( const vector_type& v, const vector_type& color )
+{
+	if( triangulate )
+		_positions.push_back( v );
+
+	vertexSignal.send( v );
+	vertexColorSignal.send( color );
+	++_numVertices;
+}
+
+template<typename Real>
+void basic_objparser<Real>::normal( const vector_type& n )
+{
+	normalSignal.send( n );
+	++_numNormals;
+}
+
+template<typename Real>
+void basic_objparser<Real>::texcoord( const vector_type& t )
+{
+	texcoordSignal.send( t );
+	++_numTexCoords;
+}
+
+template<typename Real>
+void basic_objparser<Real>::parameter( const vector_type& p )
+{
+	parameterSignal.send( p );
+}
+
+template<typename Real>
+void basic_objparser<Real>::faceBegin( unsigned int numElements )
+{
+	// Sent once all elements are known
+	if( triangulate )
+		_face.clear();
+	else
+		faceBeginSignal.send( numElements );
+}
+
+template<typename Real>
+void basic_objparser<Real>::faceElement( face_index& idx )
+{
 	// Check if we need to convert negative indices
 	if( convertNegativeIndices )
 		convertNegativeIndex( idx );
 
-	return true;
+	if( triangulate )
+		_face.push_back( idx );
+	else
+		faceElementSignal.send( idx );
+}
+
+template<typename Real>
+void basic_objparser<Real>::faceEnd()
+{
+	if( triangulate )
+		sendFace( _face.empty() ? 0 : &_face[0], (unsigned int)_face.size() );
+	else
+		faceEndSignal.send();
+}
+
+template<typename Real>
+void basic_objparser<Real>::objectName( const char* name, const char* nameEnd )
+{
+	objectNameIdSignal.send( _names.intern( name, nameEnd ) );
+
+	_name.assign( name, nameEnd );
+	objectNameSignal.send( _name );
+}
+
+template<typename Real>
+void basic_objparser<Real>::groupName( const char* name, const char* nameEnd )
+{
+	groupNameIdSignal.send( _names.intern( name, nameEnd ) );
+
+	_name.assign( name, nameEnd );
+	groupNameSignal.send( _name );
+}
+
+template<typename Real>
+void basic_objparser<Real>::materialLib( const std::string& filename )
+{
+	materialLibSignal.send( filename );
+}
+
+template<typename Real>
+void basic_objparser<Real>::materialUse( const char* name, const char* nameEnd )
+{
+	materialUseIdSignal.send( _names.intern( name, nameEnd ) );
+
+	_name.assign( name, nameEnd );
+	materialUseSignal.send( _name );
+}
+
+template<typename Real>
+void basic_objparser<Real>::smoothingGroup( unsigned int group )
+{
+	smoothingGroupSignal.send( group );
+}
+
+namespace obj
+{
+	template class basic_objparser<double>;
+	template class basic_objparser<float>;
 }
@@ -0,0 +1,650 @@
+#ifndef _OBJ_OBJREADER_H_
+#define _OBJ_OBJREADER_H_
+
+#include <obj/types.h>
+#include <obj/parsestats.h>
+#include "scanner.h"
+#include "timer.h"
+#include <algorithm>
+
+namespace obj
+{
+	/*
+	 *	OBJ line parser, reports everything it reads to a handler.
+	 *
+	 *	Handler interface:
+	 *		typedef ... real_type;			// precision numbers are parsed to
+	 *		typedef ... vector_type;		// vec3 of real_type
+	 *		void nextLine();
+	 *		void error( const std::string& message );
+	 *		void comment( const std::string& text );
+	 *		void vertex( const vector_type& v );
+	 *		void weightedVertex( const vector_type& v, real_type w );		// v x y z w
+	 *		void coloredVertex( const vector_type& v, const vector_type& color );	// v x y z r g b
+	 *		void normal( const vector_type& n );
+	 *		void texcoord( const vector_type& t );
+	 *		void parameter( const vector_type& p );
+	 *		void faceBegin( unsigned int numElements );
+	 *		void faceElement( face_index& idx );		// negative indices not converted yet
+	 *		void faceEnd();
+	 *		void objectName( const char* name, const char* nameEnd );
+	 *		void groupName( const char* name, const char* nameEnd );
+	 *		void materialLib( const std::string& filename );
+	 *		void materialUse( const char* name, const char* nameEnd );
+	 *		void smoothingGroup( unsigned int group );		// 0 = off
+	 *
+	 *	With Profile set, line counts and sampled conversion times are added
+	 *	to stats. Without it, all profiling code is compiled out.
+	 */
+	template<typename Handler, bool Profile = false>
+	class objreader
+	{
+	public:
+		objreader( Handler& handler, objstats* stats = 0 )
+			: _handler( handler ), _stats( stats ), _sample( 0 ), _timerOverhead( Profile ? timerOverhead() : 0.0 ), _shape( SHAPE_UNKNOWN )
+		{
+			// empty
+		}
+
+		void parseLines( const char* begin, const char* end );
+		void parseLine( const char* line, const char* end );
+
+	private:
+		typedef typename Handler::real_type real_type;
+		typedef typename Handler::vector_type vector_type;
+
+		// Number conversion is timed on one line in SAMPLE_RATE
+		enum
+		{
+			SAMPLE_RATE = 64
+		};
+
+		// Weight or color of a vertex
+		enum
+		{
+			MAX_VERTEX_EXTRAS = 3
+		};
+
+		// Faces up to this size are parsed in a single pass
+		enum
+		{
+			MAX_BUFFERED_ELEMENTS = 16
+		};
+
+		// Index tuple forms of face elements
+		enum tupleshape
+		{
+			SHAPE_UNKNOWN,
+			SHAPE_V,		// v
+			SHAPE_VT,		// v/t
+			SHAPE_VN,		// v//n
+			SHAPE_VTN		// v/t/n
+		};
+
+		// Values after the position of a vertex, up to MAX_VERTEX_EXTRAS + 1 so too many can be told apart, 0 if malformed
+		unsigned int parseVertexExtras( const char*& p, const char* end, real_type* values );
+
+		// One to three values with defaults for missing ones in t
+		bool parseTuple( const char*& p, const char* end, vector_type& t );
+
+		void parseFace( const char* first, const char* end );
+		void parseLargeFace( const char* first, const char* end );
+
+		// Element in the shape of the last element read by parseIndexTuple, p is left at its end
+		bool parseShapedTuple( face_index& idx, const char*& p, const char* end );
+
+		// Any element shape, does not report errors
+		bool parseIndexTuple( face_index& idx, const char* begin, const char* end );
+
+		void faceElement( face_index& idx, bool ok );
+
+		void count( objstats::keyword keyword )
+		{
+			if( Profile )
+				++_stats->numKeywordLines[keyword];
+		}
+
+		// Message is copied to the line buffer, so repeated errors do not allocate
+		void error( parsestats::errortype type, const char* message, const char* arg = 0, const char* argEnd = 0, const char* suffix = 0 )
+		{
+			if( Profile )
+				++_stats->numErrors[type];
+
+			_buffer.assign( message );
+			if( arg )
+			{
+				_buffer.append( arg, argEnd );
+				_buffer.append( suffix );
+			}
+
+			_handler.error( _buffer );
+		}
+
+		bool isSampled()
+		{
+			return Profile && ++_sample % SAMPLE_RATE == 0;
+		}
+
+		void addSample( double start )
+		{
+			const double elapsed = now() - start - _timerOverhead;
+			if( elapsed > 0.0 )
+				_stats->conversionTime += elapsed * SAMPLE_RATE;
+		}
+
+		Handler& _handler;
+		objstats* _stats;
+		unsigned int _sample;
+		double _timerOverhead;
+		tupleshape _shape;
+
+		// Text handed to the handler, reused by every line
+		std::string _buffer;
+	};
+
+	template<typename Handler, bool Profile>
+	void objreader<Handler, Profile>::parseLines( const char* begin, const char* end )
+	{
+		if( Profile )
+			_stats->numBytes += end - begin;
+
+		scanner::linesplitter lines( begin, end );
+		const char* line;
+		const char* lineEnd;
+
+		while( lines.next( line, lineEnd ) )
+		{
+			_handler.nextLine();
+
+			if( Profile )
+				++_stats->numLines;
+
+			parseLine( line, scanner::trimLineBreak( line, lineEnd, end ) );
+		}
+	}
+
+	template<typename Handler, bool Profile>
+	void objreader<Handler, Profile>::parseLine( const char* line, const char* end )
+	{
+		// Read until next whitespace
+		const char* p = scanner::skipSpace( line, end );
+
+		// Check empty line
+		if( p == end )
+		{
+			count( objstats::EMPTY );
+			return;
+		}
+
+		// Check comment line
+		if( *p == '#' )
+		{
+			count( objstats::COMMENT );
+			_buffer.assign( scanner::lineTextBegin( line, end ), end );
+			_handler.comment( _buffer );
+			return;
+		}
+
+		// Check keyword
+		const char* keyword = p;
+		const char* keywordEnd = scanner::skipToken( p, end );
+		p = keywordEnd;
+
+		// Case vertex
+		if( scanner::equals( keyword, keywordEnd, "v" ) )
+		{
+			count( objstats::VERTEX );
+			vector_type v;
+
+			const bool sampled = isSampled();
+			const double start = sampled ? now() : 0.0;
+			const bool ok = scanner::parseVector3( p, end, v );
+
+			if( sampled )
+				addSample( start );
+
+			if( !ok )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading vertex, skipping it." );
+				return;
+			}
+
+			// Only lines with more than a position pay for weights and colors
+			if( p != end )
+			{
+				real_type extras[MAX_VERTEX_EXTRAS + 1];
+				const unsigned int numExtras = parseVertexExtras( p, end, extras );
+
+				if( numExtras == 1 )
+				{
+					_handler.weightedVertex( v, extras[0] );
+					return;
+				}
+
+				if( numExtras == 3 )
+				{
+					vector_type color;
+					color.x = extras[0];
+					color.y = extras[1];
+					color.z = extras[2];
+
+					_handler.coloredVertex( v, color );
+					return;
+				}
+
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond third vertex value." );
+			}
+
+			_handler.vertex( v );
+		}
+		// Case normal
+		else if( scanner::equals( keyword, keywordEnd, "vn" ) )
+		{
+			count( objstats::NORMAL );
+			vector_type n;
+
+			const bool sampled = isSampled();
+			const double start = sampled ? now() : 0.0;
+			const bool ok = scanner::parseVector3( p, end, n );
+
+			if( sampled )
+				addSample( start );
+
+			if( !ok )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading normal, skipping it." );
+				return;
+			}
+
+			if( p != end )
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond third normal value." );
+
+			_handler.normal( n );
+		}
+		// Case texcoord
+		else if( scanner::equals( keyword, keywordEnd, "vt" ) )
+		{
+			count( objstats::TEXCOORD );
+			vector_type t;
+
+			const bool sampled = isSampled();
+			const double start = sampled ? now() : 0.0;
+			const bool ok = parseTuple( p, end, t );
+
+			if( sampled )
+				addSample( start );
+
+			if( !ok )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading texture coordinate, skipping it." );
+				return;
+			}
+
+			if( p != end )
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond third texcoord value." );
+
+			_handler.texcoord( t );
+		}
+		// Case point in parameter space
+		else if( scanner::equals( keyword, keywordEnd, "vp" ) )
+		{
+			count( objstats::PARAMETER );
+			vector_type param;
+
+			// Weight of rational curves and surfaces
+			param.z = 1;
+
+			const bool sampled = isSampled();
+			const double start = sampled ? now() : 0.0;
+			const bool ok = parseTuple( p, end, param );
+
+			if( sampled )
+				addSample( start );
+
+			if( !ok )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading parameter space vertex, skipping it." );
+				return;
+			}
+
+			if( p != end )
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond third parameter space value." );
+
+			_handler.parameter( param );
+		}
+		// Case face
+		else if( scanner::equals( keyword, keywordEnd, "f" ) || scanner::equals( keyword, keywordEnd, "fo" ) )
+		{
+			count( objstats::FACE );
+			const char* first = scanner::skipSpace( p, end );
+
+			if( first == end )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading face list, skipping it." );
+				return;
+			}
+
+			parseFace( first, end );
+		}
+		// Case object name
+		else if( scanner::equals( keyword, keywordEnd, "o" ) )
+		{
+			count( objstats::OBJECT_NAME );
+			_handler.objectName( scanner::lineTextBegin( line, end ), end );
+		}
+		// Case group name
+		else if( scanner::equals( keyword, keywordEnd, "g" ) )
+		{
+			count( objstats::GROUP_NAME );
+			_handler.groupName( scanner::lineTextBegin( line, end ), end );
+		}
+		// Case material filename
+		else if( scanner::equals( keyword, keywordEnd, "mtllib" ) )
+		{
+			count( objstats::MATERIAL_LIB );
+
+			// Every word is followed by a space, trailing whitespace is an error
+			std::string& filename = _buffer;
+			filename.clear();
+
+			while( p != end )
+			{
+				p = scanner::skipSpace( p, end );
+
+				if( p == end )
+				{
+					error( parsestats::MALFORMED_ERROR, "Parse error reading material library filename, skipping it." );
+					return;
+				}
+
+				const char* word = p;
+				p = scanner::skipToken( p, end );
+
+				filename.append( word, p );
+				filename += ' ';
+			}
+
+			_handler.materialLib( filename );
+		}
+		// Case material use
+		else if( scanner::equals( keyword, keywordEnd, "usemtl" ) )
+		{
+			count( objstats::MATERIAL_USE );
+			const char* material = scanner::skipSpace( p, end );
+			p = scanner::skipToken( material, end );
+
+			if( material == end )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading material name, skipping it." );
+				return;
+			}
+
+			const char* materialEnd = p;
+			p = scanner::skipSpace( p, end );
+
+			if( p != end )
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond first material name." );
+
+			_handler.materialUse( material, materialEnd );
+		}
+		// Case smoothing group
+		else if( scanner::equals( keyword, keywordEnd, "s" ) )
+		{
+			count( objstats::SMOOTHING_GROUP );
+			const char* group = scanner::skipSpace( p, end );
+			p = scanner::skipToken( group, end );
+
+			// Number or off
+			int number = 0;
+			const char* s = group;
+
+			if( !scanner::equals( group, p, "off" ) && ( !scanner::parseInt( s, p, number ) || s != p || number < 0 ) )
+			{
+				error( parsestats::MALFORMED_ERROR, "Parse error reading smoothing group, skipping it." );
+				return;
+			}
+
+			p = scanner::skipSpace( p, end );
+
+			if( p != end )
+				error( parsestats::EXTRA_DATA_ERROR, "Ignoring information beyond smoothing group." );
+
+			_handler.smoothingGroup( (unsigned int)number );
+		}
+		// Case unknown
+		else
+		{
+			count( objstats::UNKNOWN );
+			error( parsestats::UNKNOWN_KEYWORD_ERROR, "Unknown keyword '", keyword, keywordEnd, "', skipping line." );
+		}
+	}
+
+	template<typename Handler, bool Profile>
+	unsigned int objreader<Handler, Profile>::parseVertexExtras( const char*& p, const char* end, real_type* values )
+	{
+		unsigned int numValues = 0;
+
+		while( p != end && numValues <= MAX_VERTEX_EXTRAS )
+		{
+			if( !scanner::parseReal( p, end, values[numValues++] ) )
+				return 0;
+
+			p = scanner::skipSpace( p, end );
+		}
+
+		return ( p == end ) ? numValues : 0;
+	}
+
+	template<typename Handler, bool Profile>
+	bool objreader<Handler, Profile>::parseTuple( const char*& p, const char* end, vector_type& t )
+	{
+		p = scanner::skipSpace( p, end );
+		bool ok = scanner::parseReal( p, end, t.x );
+		p = scanner::skipSpace( p, end );
+
+		// Optional parameter
+		if( ok && p != end )
+		{
+			ok = scanner::parseReal( p, end, t.y );
+			p = scanner::skipSpace( p, end );
+		}
+
+		// Optional parameter
+		if( ok && p != end )
+		{
+			ok = scanner::parseReal( p, end, t.z );
+			p = scanner::skipSpace( p, end );
+		}
+
+		return ok;
+	}
+
+	template<typename Handler, bool Profile>
+	void objreader<Handler, Profile>::parseFace( const char* first, const char* end )
+	{
+		face_index elements[MAX_BUFFERED_ELEMENTS];
+		bool valid[MAX_BUFFERED_ELEMENTS];
+		unsigned int numElements = 0;
+
+		const bool sampled = isSampled();
+		const double start = sampled ? now() : 0.0;
+
+		// Parse elements before notifying their count, errors are reported in order afterwards
+		const char* p = first;
+		for( ; p != end && numElements < MAX_BUFFERED_ELEMENTS; ++numElements )
+		{
+			face_index& idx = elements[numElements];
+			const char* elem = p;
+
+			valid[numElements] = parseShapedTuple( idx, p, end );
+			if( !valid[numElements] )
+			{
+				p = scanner::skipToken( elem, end );
+				idx = face_index();
+				valid[numElements] = parseIndexTuple( idx, elem, p );
+			}
+
+			p = scanner::skipSpace( p, end );
+		}
+
+		if( sampled )
+			addSample( start );
+
+		if( p != end )
+		{
+			parseLargeFace( first, end );
+			return;
+		}
+
+		if( Profile )
+			++_stats->faceSizes[std::min<unsigned int>( numElements, objstats::MAX_FACE_SIZE )];
+
+		_handler.faceBegin( numElements );
+
+		for( unsigned int i = 0; i < numElements; ++i )
+			faceElement( elements[i], valid[i] );
+
+		_handler.faceEnd();
+	}
+
+	template<typename Handler, bool Profile>
+	void objreader<Handler, Profile>::parseLargeFace( const char* first, const char* end )
+	{
+		// Count elements before notifying
+		unsigned int numElements = 0;
+		for( const char* p = first; p != end; p = scanner::skipSpace( scanner::skipToken( p, end ), end ) )
+			++numElements;
+
+		if( Profile )
+			++_stats->faceSizes[objstats::MAX_FACE_SIZE];
+
+		_handler.faceBegin( numElements );
+
+		for( const char* p = first; p != end; p = scanner::skipSpace( p, end ) )
+		{
+			const char* elem = p;
+			p = scanner::skipToken( p, end );
+
+			face_index idx;
+			faceElement( idx, parseIndexTuple( idx, elem, p ) );
+		}
+
+		_handler.faceEnd();
+	}
+
+	template<typename Handler, bool Profile>
+	bool objreader<Handler, Profile>::parseShapedTuple( face_index& idx, const char*& p, const char* end )
+	{
+		const char* s = p;
+
+		// Texture index never has a sign, see parseIndexTuple
+		switch( _shape )
+		{
+		case SHAPE_V:
+			if( !scanner::parseInt( s, end, idx.vertexIdx ) )
+				return false;
+			break;
+
+		case SHAPE_VT:
+			if( !scanner::parseInt( s, end, idx.vertexIdx ) || s == end || *s != '/' ||
+				++s == end || !scanner::isDigit( *s ) || !scanner::parseInt( s, end, idx.texCoordIdx ) )
+				return false;
+			break;
+
+		case SHAPE_VN:
+			if( !scanner::parseInt( s, end, idx.vertexIdx ) || end - s < 2 || s[0] != '/' || s[1] != '/' )
+				return false;
+
+			s += 2;
+			if( !scanner::parseInt( s, end, idx.normalIdx ) )
+				return false;
+			break;
+
+		case SHAPE_VTN:
+			if( !scanner::parseInt( s, end, idx.vertexIdx ) || s == end || *s != '/' ||
+				++s == end || !scanner::isDigit( *s ) || !scanner::parseInt( s, end, idx.texCoordIdx ) ||
+				s == end || *s != '/' )
+				return false;
+
+			++s;
+			if( !scanner::parseInt( s, end, idx.normalIdx ) )
+				return false;
+			break;
+
+		default:
+			return false;
+		}
+
+		// Element must end here
+		if( s != end && !scanner::isSpace( *s ) )
+			return false;
+
+		p = s;
+		return true;
+	}
+
+	template<typename Handler, bool Profile>
+	void objreader<Handler, Profile>::faceElement( face_index& idx, bool ok )
+	{
+		if( !ok )
+		{
+			error( parsestats::MALFORMED_ERROR, "Parse error reading face element, skipping it." );
+			return;
+		}
+
+		if( Profile )
+			_stats->numNegativeIndices += ( idx.vertexIdx < 0 ) + ( idx.texCoordIdx < 0 ) + ( idx.normalIdx < 0 );
+
+		_handler.faceElement( idx );
+	}
+
+	template<typename Handler, bool Profile>
+	bool objreader<Handler, Profile>::parseIndexTuple( face_index& idx, const char* begin, const char* end )
+	{
+		const char* p = begin;
+		bool hasTexCoord = false;
+		bool hasNormal = false;
+
+		// Possible cases: v, v/t, v//n, v/t/n
+		bool ok = scanner::parseInt( p, end, idx.vertexIdx );
+
+		// Check for t and n indices
+		if( ok && p != end && *p == '/' )
+		{
+			++p;
+
+			if( p != end && scanner::isDigit( *p ) )
+			{
+				// We have at least v/t
+				ok = scanner::parseInt( p, end, idx.texCoordIdx );
+				hasTexCoord = true;
+			}
+
+			// Case v//n or v/t/n
+			if( ok && p != end && *p == '/' )
+			{
+				++p;
+				ok = scanner::parseInt( p, end, idx.normalIdx );
+				hasNormal = true;
+			}
+			else if( !hasTexCoord )
+			{
+				// Trailing slash, keep current shape
+				return ok && p == end;
+			}
+		}
+
+		if( !ok || p != end )
+			return false;
+
+		// Try this shape first for the next elements
+		if( hasNormal )
+			_shape = hasTexCoord ? SHAPE_VTN : SHAPE_VN;
+		else
+			_shape = hasTexCoord ? SHAPE_VT : SHAPE_V;
+
+		return true;
+	}
+}
+
+#endif // _OBJ_OBJREADER_H_
@@ -0,0 +1,88 @@
+#include <obj/parsestats.h>
+#include <cstring>
+
+using namespace obj;
+
+//////////////////////////////////////////////////////////////////////////
+// parsestats
+//////////////////////////////////////////////////////////////////////////
+parsestats::parsestats()
+{
+	clear();
+}
+
+void parsestats::clear()
+{
+	numBytes = 0;
+	numLines = 0;
+	memset( numErrors, 0, sizeof( numErrors ) );
+
+	totalTime = 0.0;
+	ioTime = 0.0;
+	tokenizeTime = 0.0;
+	conversionTime = 0.0;
+	dispatchTime = 0.0;
+}
+
+void parsestats::merge( const parsestats& other )
+{
+	numBytes += other.numBytes;
+	numLines += other.numLines;
+
+	for( int i = 0; i < NUM_ERROR_TYPES; ++i )
+		numErrors[i] += other.numErrors[i];
+
+	totalTime += other.totalTime;
+	ioTime += other.ioTime;
+	tokenizeTime += other.tokenizeTime;
+	conversionTime += other.conversionTime;
+	dispatchTime += other.dispatchTime;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// objstats
+//////////////////////////////////////////////////////////////////////////
+objstats::objstats()
+{
+	clear();
+}
+
+void objstats::clear()
+{
+	parsestats::clear();
+
+	memset( numKeywordLines, 0, sizeof( numKeywordLines ) );
+	memset( faceSizes, 0, sizeof( faceSizes ) );
+	numNegativeIndices = 0;
+	numClippedFaces = 0;
+	fromCache = false;
+}
+
+void objstats::merge( const objstats& other )
+{
+	parsestats::merge( other );
+
+	for( int i = 0; i < NUM_KEYWORDS; ++i )
+		numKeywordLines[i] += other.numKeywordLines[i];
+
+	for( int i = 0; i <= MAX_FACE_SIZE; ++i )
+		faceSizes[i] += other.faceSizes[i];
+
+	numNegativeIndices += other.numNegativeIndices;
+	numClippedFaces += other.numClippedFaces;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// mtlstats
+//////////////////////////////////////////////////////////////////////////
+mtlstats::mtlstats()
+{
+	clear();
+}
+
+void mtlstats::clear()
+{
+	parsestats::clear();
+
+	memset( numKeywordLines, 0, sizeof( numKeywordLines ) );
+}
@@ -0,0 +1,535 @@
+#ifndef _OBJ_SCANNER_H_
+#define _OBJ_SCANNER_H_
+
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+#include "timer.h"
+
+#if defined( _MSC_VER )
+	#include <intrin.h>
+#endif
+
+namespace obj
+{
+	/*
+	 *	Character level helpers shared by the parsers.
+	 *
+	 *	Token and number functions work on [begin, end) ranges of a
+	 *	contiguous buffer and never allocate. Whitespace and number syntax follow the
+	 *	classic "C" locale, matching what std::stringstream accepted.
+	 */
+	namespace scanner
+	{
+		inline bool isSpace( char c )
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+		}
+
+		inline bool isDigit( char c )
+		{
+			return (unsigned char)( c - '0' ) < 10;
+		}
+
+		inline const char* skipSpace( const char* p, const char* end )
+		{
+			while( p != end && isSpace( *p ) )
+				++p;
+			return p;
+		}
+
+		inline const char* skipToken( const char* p, const char* end )
+		{
+			while( p != end && !isSpace( *p ) )
+				++p;
+			return p;
+		}
+
+		// Find end of current line (position of '\n' or end)
+		const char* findLineEnd( const char* p, const char* end );
+
+		// Find last '\n' in range, or null if none
+		const char* findLastLineEnd( const char* begin, const char* end );
+
+		// Bit i is set if p[i] is '\n', for the 64 bytes at p. Uses AVX2 or SSE2 when the processor has them
+		extern unsigned long long (* const lineEndMask)( const char* p );
+
+		// Instruction set chosen for lineEndMask: "avx2", "sse2" or "scalar"
+		const char* instructionSet();
+
+		// Index of lowest set bit of non zero mask
+		inline unsigned int lowestBit( unsigned long long mask )
+		{
+#if defined( _MSC_VER )
+			unsigned long index;
+			if( _BitScanForward( &index, (unsigned long)mask ) )
+				return index;
+
+			_BitScanForward( &index, (unsigned long)( mask >> 32 ) );
+			return index + 32;
+#else
+			return (unsigned int)__builtin_ctzll( mask );
+#endif
+		}
+
+		/*
+		 *	Splits a range into lines, finding the line breaks of 64 bytes
+		 *	at a time with lineEndMask. Bytes past the end are never read.
+		 */
+		class linesplitter
+		{
+		public:
+			linesplitter( const char* begin, const char* end )
+				: _next( begin ), _block( begin ), _end( end ), _mask( blockMask( begin, end ) )
+			{
+				// empty
+			}
+
+			// Next line [line, lineEnd), lineEnd is its '\n' or end of range
+			bool next( const char*& line, const char*& lineEnd )
+			{
+				if( _next == _end )
+					return false;
+
+				line = _next;
+
+				while( _mask == 0 )
+				{
+					if( _end - _block <= BLOCK_SIZE )
+					{
+						// Last line without line break
+						lineEnd = _end;
+						_next = _end;
+						return true;
+					}
+
+					_block += BLOCK_SIZE;
+					_mask = blockMask( _block, _end );
+				}
+
+				lineEnd = _block + lowestBit( _mask );
+				_mask &= _mask - 1;
+				_next = lineEnd + 1;
+				return true;
+			}
+
+		private:
+			enum
+			{
+				BLOCK_SIZE = 64
+			};
+
+			static unsigned long long blockMask( const char* block, const char* end )
+			{
+				if( end - block >= BLOCK_SIZE )
+					return lineEndMask( block );
+
+				unsigned long long mask = 0;
+				for( unsigned int i = 0; block + i != end; ++i )
+					mask |= (unsigned long long)( block[i] == '\n' ) << i;
+				return mask;
+			}
+
+			const char* _next;
+			const char* _block;
+			const char* _end;
+			unsigned long long _mask;
+		};
+
+		// Exclude the '\r' of a "\r\n" line break from line [begin, lineEnd)
+		inline const char* trimLineBreak( const char* begin, const char* lineEnd, const char* end )
+		{
+			if( lineEnd != end && lineEnd != begin && lineEnd[-1] == '\r' )
+				return lineEnd - 1;
+			return lineEnd;
+		}
+
+		// Check if token [begin, end) equals zero terminated keyword
+		inline bool equals( const char* begin, const char* end, const char* keyword )
+		{
+			for( ; begin != end; ++begin, ++keyword )
+			{
+				if( *begin != *keyword )
+					return false;
+			}
+			return *keyword == '\0';
+		}
+
+		// Decimal integer with optional sign, fails on overflow
+		inline bool parseInt( const char*& p, const char* end, int& value )
+		{
+			const char* s = p;
+			bool negative = false;
+
+			if( s != end && ( *s == '-' || *s == '+' ) )
+			{
+				negative = ( *s == '-' );
+				++s;
+			}
+
+			if( s == end || !isDigit( *s ) )
+				return false;
+
+			// Wide enough that ten digits cannot wrap, checked once per digit without division
+			const unsigned long long limit = negative ? 2147483648ull : 2147483647ull;
+			unsigned long long v = 0;
+
+			do
+			{
+				v = v * 10 + (unsigned int)( *s - '0' );
+				if( v > limit )
+					return false;
+				++s;
+			}
+			while( s != end && isDigit( *s ) );
+
+			value = negative ? (int)( 0u - (unsigned int)v ) : (int)v;
+			p = s;
+			return true;
+		}
+
+		// Recount digits [begin, end) of a number without leading zeros, keeps the first 19 in mantissa and adds
+		// the number of those dropped to exponent
+		void significantDigits( const char* begin, const char* end, unsigned long long& mantissa, int& numDigits,
+								int& exponent );
+
+		// Split number [sign] digits [. digits] [e [sign] digits] into sign, decimal mantissa and exponent,
+		// above 19 significant digits mantissa is truncated to 19
+		inline bool scanDecimal( const char*& p, const char* end, bool& negative, unsigned long long& mantissa,
+								 int& numDigits, int& exponent )
+		{
+			const char* s = p;
+			negative = false;
+
+			if( s != end && ( *s == '-' || *s == '+' ) )
+			{
+				negative = ( *s == '-' );
+				++s;
+			}
+
+			mantissa = 0;
+			const char* digitsBegin = s;
+
+			while( s != end && isDigit( *s ) )
+			{
+				mantissa = mantissa * 10 + (unsigned int)( *s - '0' );
+				++s;
+			}
+
+			numDigits = (int)( s - digitsBegin );
+			exponent = 0;
+
+			if( s != end && *s == '.' )
+			{
+				const char* fractionBegin = ++s;
+
+				while( s != end && isDigit( *s ) )
+				{
+					mantissa = mantissa * 10 + (unsigned int)( *s - '0' );
+					++s;
+				}
+
+				exponent = -(int)( s - fractionBegin );
+				numDigits -= exponent;
+			}
+
+			if( numDigits == 0 )
+				return false;
+
+			// Mantissa overflowed, or holds leading zeros
+			if( numDigits > 19 )
+				significantDigits( digitsBegin, s, mantissa, numDigits, exponent );
+
+			if( s != end && ( *s == 'e' || *s == 'E' ) )
+			{
+				++s;
+				bool negativeExp = false;
+
+				if( s != end && ( *s == '-' || *s == '+' ) )
+				{
+					negativeExp = ( *s == '-' );
+					++s;
+				}
+
+				if( s == end || !isDigit( *s ) )
+					return false;
+
+				int e = 0;
+				while( s != end && isDigit( *s ) )
+				{
+					if( e < 100000 )
+						e = e * 10 + ( *s - '0' );
+					++s;
+				}
+
+				exponent += negativeExp ? -e : e;
+			}
+
+			p = s;
+			return true;
+		}
+
+		// Exact mantissa and exact power of ten: a single rounding gives the correct result
+		inline bool fastDouble( unsigned long long mantissa, int numDigits, int exponent, double& value )
+		{
+			static const double powersOf10[] = {
+				1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+			};
+
+			if( numDigits > 19 || mantissa > ( 1ull << 53 ) || exponent < -22 || exponent > 22 )
+				return false;
+
+			const double d = (double)mantissa;
+			value = ( exponent < 0 ) ? d / powersOf10[-exponent] : d * powersOf10[exponent];
+			return true;
+		}
+
+		// Correctly rounded mantissa * 10^exponent with the Eisel-Lemire algorithm, infinite on overflow.
+		// Fails in the rare cases the 128 bit powers of five are not precise enough to decide
+		bool computeDouble( unsigned long long mantissa, int exponent, double& value );
+		bool computeFloat( unsigned long long mantissa, int exponent, float& value );
+
+		// Either a truncated mantissa and the next one round the same way or the truncated digits matter
+		template<typename Real>
+		bool computeReal( unsigned long long mantissa, int numDigits, int exponent, Real& value,
+						  bool (*compute)( unsigned long long, int, Real& ) )
+		{
+			if( !compute( mantissa, exponent, value ) )
+				return false;
+
+			if( numDigits <= 19 )
+				return true;
+
+			Real next;
+			return compute( mantissa + 1, exponent, next ) && next == value;
+		}
+
+		// Slow path for parseDouble, converts an already validated number
+		bool parseDoubleSlow( const char* begin, const char* end, double& value );
+
+		// Floating point number: [sign] digits [. digits] [e [sign] digits]
+		inline bool parseDouble( const char*& p, const char* end, double& value )
+		{
+			const char* s = p;
+			bool negative;
+			unsigned long long mantissa;
+			int numDigits;
+			int exponent;
+
+			if( !scanDecimal( s, end, negative, mantissa, numDigits, exponent ) )
+				return false;
+
+			double d;
+
+			if( fastDouble( mantissa, numDigits, exponent, d ) ||
+				computeReal( mantissa, numDigits, exponent, d, computeDouble ) )
+			{
+				// Overflow is an error, as it was for stream extraction
+				if( d > DBL_MAX )
+					return false;
+
+				value = negative ? -d : d;
+			}
+			else if( !parseDoubleSlow( p, s, value ) )
+			{
+				return false;
+			}
+
+			p = s;
+			return true;
+		}
+
+		// Sign of the difference between the magnitude of validated number [begin, end) and value, exact
+		int compareDecimal( const char* begin, const char* end, double value );
+
+		// Positive double halfway between two normal floats, or below their range
+		inline bool isFloatTie( double d )
+		{
+			unsigned long long bits;
+			memcpy( &bits, &d, sizeof( bits ) );
+			return ( bits >> 52 ) < 1023 - 126 || ( bits & 0x1FFFFFFFull ) == 0x10000000ull;
+		}
+
+		// Slow path for parseFloat, converts an already validated number
+		bool parseFloatSlow( const char* begin, const char* end, float& value );
+
+		// Same syntax as parseDouble, rounded to single precision
+		inline bool parseFloat( const char*& p, const char* end, float& value )
+		{
+			static const float powersOf10[] = {
+				1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+			};
+
+			const char* s = p;
+			bool negative;
+			unsigned long long mantissa;
+			int numDigits;
+			int exponent;
+
+			if( !scanDecimal( s, end, negative, mantissa, numDigits, exponent ) )
+				return false;
+
+			double d;
+			float f;
+
+			// Exact in single precision, typical for coordinates written with up to 7 digits
+			if( numDigits <= 19 && mantissa <= ( 1u << 24 ) && exponent >= -10 && exponent <= 10 )
+			{
+				f = (float)mantissa;
+				f = ( exponent < 0 ) ? f / powersOf10[-exponent] : f * powersOf10[exponent];
+				value = negative ? -f : f;
+			}
+			// Correctly rounded double rounded again, wrong only when it fell exactly between two floats
+			else if( fastDouble( mantissa, numDigits, exponent, d ) && !isFloatTie( d ) )
+			{
+				value = (float)( negative ? -d : d );
+			}
+			else if( computeReal( mantissa, numDigits, exponent, f, computeFloat ) )
+			{
+				if( f > FLT_MAX )
+					return false;
+
+				value = negative ? -f : f;
+			}
+			else if( !parseFloatSlow( p, s, value ) )
+			{
+				return false;
+			}
+
+			p = s;
+			return true;
+		}
+
+		// Precision selected by argument type
+		inline bool parseReal( const char*& p, const char* end, double& value )
+		{
+			return parseDouble( p, end, value );
+		}
+
+		inline bool parseReal( const char*& p, const char* end, float& value )
+		{
+			return parseFloat( p, end, value );
+		}
+
+		// Three whitespace separated numbers, also skips whitespace after them
+		template<typename Vec>
+		bool parseVector3( const char*& p, const char* end, Vec& v )
+		{
+			p = skipSpace( p, end );
+			if( !parseReal( p, end, v.x ) )
+				return false;
+
+			p = skipSpace( p, end );
+			if( !parseReal( p, end, v.y ) )
+				return false;
+
+			p = skipSpace( p, end );
+			if( !parseReal( p, end, v.z ) )
+				return false;
+
+			p = skipSpace( p, end );
+			return true;
+		}
+
+		// Text after the first two characters of a line, as reported for comments and names
+		inline const char* lineTextBegin( const char* line, const char* end )
+		{
+			return ( end - line < 2 ) ? end : line + 2;
+		}
+
+		inline std::string lineText( const char* line, const char* end )
+		{
+			if( end - line < 2 )
+				return std::string();
+
+			return std::string( line + 2, end );
+		}
+
+		// Size of blocks read from input streams
+		const size_t STREAM_BLOCK_SIZE = 1 << 20;
+
+		// Read stream in blocks, handing runs of complete lines to parser, adds time spent reading to readTime if set
+		template<typename Parser>
+		void readStream( std::istream& file, Parser& parser, void (Parser::*parseLines)( const char*, const char* ),
+						 size_t blockSize = STREAM_BLOCK_SIZE, double* readTime = 0 )
+		{
+			std::vector<char> buffer( blockSize );
+			size_t filled = 0;
+
+			while( file )
+			{
+				// Grow buffer if a single line does not fit
+				if( filled == buffer.size() )
+					buffer.resize( buffer.size() * 2 );
+
+				const double start = readTime ? now() : 0.0;
+
+				file.read( &buffer[filled], (std::streamsize)( buffer.size() - filled ) );
+				filled += (size_t)file.gcount();
+
+				if( readTime )
+					*readTime += now() - start;
+
+				const char* begin = &buffer[0];
+				const char* last = findLastLineEnd( begin, begin + filled );
+				if( !last )
+					continue;
+
+				// Parse complete lines and keep the partial one for next block
+				( parser.*parseLines )( begin, last + 1 );
+
+				size_t consumed = last + 1 - begin;
+				memmove( &buffer[0], &buffer[consumed], filled - consumed );
+				filled -= consumed;
+			}
+
+			// Last line without line break
+			if( filled > 0 )
+				( parser.*parseLines )( &buffer[0], &buffer[0] + filled );
+		}
+
+		// Hand complete lines of a block of data to parser, a line split across blocks is kept in partialLine
+		template<typename Parser>
+		void parseBlock( const char* data, const char* end, std::vector<char>& partialLine,
+						 Parser& parser, void (Parser::*parseLines)( const char*, const char* ) )
+		{
+			const char* last = findLastLineEnd( data, end );
+			if( !last )
+			{
+				partialLine.insert( partialLine.end(), data, end );
+				return;
+			}
+
+			// Complete line started in previous block
+			if( !partialLine.empty() )
+			{
+				const char* next = findLineEnd( data, end ) + 1;
+				partialLine.insert( partialLine.end(), data, next );
+				( parser.*parseLines )( &partialLine[0], &partialLine[0] + partialLine.size() );
+				data = next;
+			}
+
+			// Remaining lines straight from block
+			if( data != last + 1 )
+				( parser.*parseLines )( data, last + 1 );
+
+			partialLine.assign( last + 1, end );
+		}
+
+		// Hand last line without line break to parser
+		template<typename Parser>
+		void parseLastLine( std::vector<char>& partialLine, Parser& parser, void (Parser::*parseLines)( const char*, const char* ) )
+		{
+			if( !partialLine.empty() )
+				( parser.*parseLines )( &partialLine[0], &partialLine[0] + partialLine.size() );
+
+			partialLine.clear();
+		}
+	}
+}
+
+#endif // _OBJ_SCANNER_H_
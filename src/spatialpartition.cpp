@@ -0,0 +1,552 @@
+#include <obj/spatialpartition.h>
+#include <obj/objparser.h>
+#include "mappedfile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace obj;
+
+namespace
+{
+	const char MAGIC[8] = { 'O', 'B', 'J', 'T', 'I', 'L', 'E', 0 };
+
+	// Increment whenever the layout below changes
+	const unsigned long long VERSION = 1;
+
+	// Followed by positions, texcoords, normals, face sizes and face elements
+	struct tileheader
+	{
+		char magic[8];
+		unsigned long long version;
+		unsigned long long realSize;
+		long long x;
+		long long y;
+		long long z;
+		unsigned long long numPositions;
+		unsigned long long numTexCoords;
+		unsigned long long numNormals;
+		unsigned long long numFaces;
+		unsigned long long numFaceElements;
+	};
+
+	// Unsigned ints per face element in face buffers
+	const unsigned int ELEMENT_SIZE = sizeof( face_index ) / sizeof( unsigned int );
+
+	// Sorted unique values
+	void makeSet( std::vector<unsigned int>& values )
+	{
+		std::sort( values.begin(), values.end() );
+		values.erase( std::unique( values.begin(), values.end() ), values.end() );
+	}
+
+	// 1 based position of global 1 based index in set, zero stays zero
+	int localIndex( const std::vector<unsigned int>& set, int index )
+	{
+		if( index == 0 )
+			return 0;
+
+		return (int)( std::lower_bound( set.begin(), set.end(), (unsigned int)index - 1 ) - set.begin() ) + 1;
+	}
+
+	// Copy attributes of set from array mapped in file order
+	template<typename T>
+	void gather( std::vector<T>& out, const std::vector<unsigned int>& set, const char* data )
+	{
+		out.resize( set.size() );
+		for( size_t i = 0; i < set.size(); ++i )
+			memcpy( &out[i], data + (size_t)set[i] * sizeof( T ), sizeof( T ) );
+	}
+
+	template<typename T>
+	void writeArray( std::ofstream& file, const std::vector<T>& v )
+	{
+		if( !v.empty() )
+			file.write( (const char*)&v[0], (std::streamsize)( v.size() * sizeof( T ) ) );
+	}
+
+	template<typename T>
+	bool readArray( std::ifstream& file, std::vector<T>& v, unsigned long long count )
+	{
+		v.resize( (size_t)count );
+		if( !v.empty() )
+			file.read( (char*)&v[0], (std::streamsize)( v.size() * sizeof( T ) ) );
+
+		return !file.fail();
+	}
+
+	// Cell along one axis, values out of int range and NaN fall in the outermost cells
+	int cellCoordinate( double value, double cellSize )
+	{
+		const double c = std::floor( value / cellSize );
+
+		if( c >= 2147483647.0 )
+			return 2147483647;
+
+		if( !( c > -2147483648.0 ) )
+			return -2147483647 - 1;
+
+		return (int)c;
+	}
+
+	unsigned long processId()
+	{
+#ifdef _WIN32
+		return (unsigned long)GetCurrentProcessId();
+#else
+		return (unsigned long)getpid();
+#endif
+	}
+
+	// Map file of count records, nothing to map if empty
+	bool mapArray( mappedfile& mapping, const std::string& filename, unsigned int count )
+	{
+		return count == 0 || mapping.open( filename.c_str() );
+	}
+}
+
+template<typename Real>
+basic_spatialpartition<Real>::basic_spatialpartition( const std::string& directory, Real cellSize )
+	: _directory( directory ), _cellSize( cellSize ), _numTexCoords( 0 ), _numNormals( 0 ), _numSkippedFaces( 0 ),
+	  _lastTile( ~0u ), _failed( false )
+{
+	facePolicy = FIRST_VERTEX;
+	tileBufferSize = 64 * 1024;
+
+	_lastCell.x = 0;
+	_lastCell.y = 0;
+	_lastCell.z = 0;
+
+	// Partitions of other threads and processes may share the directory
+	char prefix[64];
+	sprintf( prefix, "partition_%lu_%p_", processId(), (const void*)this );
+	_tempPrefix = prefix;
+
+	// Zero, negative, infinite and NaN sizes give no grid, finish() reports it
+	if( !( cellSize > 0 ) || cellSize > std::numeric_limits<Real>::max() )
+	{
+		_failed = true;
+		return;
+	}
+
+	_positions.open( tempFile( "positions" ).c_str(), std::ios::binary | std::ios::trunc );
+	_texcoords.open( tempFile( "texcoords" ).c_str(), std::ios::binary | std::ios::trunc );
+	_normals.open( tempFile( "normals" ).c_str(), std::ios::binary | std::ios::trunc );
+
+	if( !_positions || !_texcoords || !_normals )
+		_failed = true;
+}
+
+template<typename Real>
+basic_spatialpartition<Real>::~basic_spatialpartition()
+{
+	// Abandoned before finish()
+	_positions.close();
+	_texcoords.close();
+	_normals.close();
+	removeTempFiles();
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::connect( basic_objparser<Real>& parser )
+{
+	parser.batchSink = this;
+}
+
+template<typename Real>
+bool basic_spatialpartition<Real>::finish()
+{
+	for( unsigned int t = 0; t < _faces.size(); ++t )
+		if( _faces[t].spilled )
+			spill( t );
+
+	_positions.close();
+	_texcoords.close();
+	_normals.close();
+
+	if( _positions.fail() || _texcoords.fail() || _normals.fail() )
+		_failed = true;
+
+	// Attributes are read back in any order
+	mappedfile positions;
+	mappedfile texcoords;
+	mappedfile normals;
+
+	if( !mapArray( positions, tempFile( "positions" ), (unsigned int)_vertexTiles.size() ) ||
+		!mapArray( texcoords, tempFile( "texcoords" ), _numTexCoords ) ||
+		!mapArray( normals, tempFile( "normals" ), _numNormals ) )
+		_failed = true;
+
+	if( !_failed )
+	{
+		// Vertices of each tile, counting sort of vertex indices by tile
+		std::vector<unsigned int> offsets( _tiles.size() + 1, 0 );
+		for( size_t i = 0; i < _vertexTiles.size(); ++i )
+			++offsets[_vertexTiles[i] + 1];
+
+		for( size_t t = 0; t < _tiles.size(); ++t )
+			offsets[t + 1] += offsets[t];
+
+		std::vector<unsigned int> owned( _vertexTiles.size() );
+		std::vector<unsigned int> next( offsets.begin(), offsets.end() - 1 );
+		for( size_t i = 0; i < _vertexTiles.size(); ++i )
+			owned[next[_vertexTiles[i]]++] = (unsigned int)i;
+
+		std::vector<unsigned int>().swap( _vertexTiles );
+
+		for( unsigned int t = 0; t < _tiles.size() && !_failed; ++t )
+		{
+			const std::vector<unsigned int> tileVertices( owned.begin() + offsets[t], owned.begin() + offsets[t + 1] );
+
+			if( !writeTile( t, tileVertices, positions.data(), texcoords.data(), normals.data() ) )
+				_failed = true;
+		}
+	}
+
+	positions.close();
+	texcoords.close();
+	normals.close();
+	removeTempFiles();
+
+	return !_failed;
+}
+
+template<typename Real>
+bool basic_spatialpartition<Real>::readTile( const std::string& filename, tiledata& data )
+{
+	std::ifstream file( filename.c_str(), std::ios::binary );
+
+	tileheader header;
+	if( !file.read( (char*)&header, sizeof( header ) ) )
+		return false;
+
+	if( memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.version != VERSION || header.realSize != sizeof( Real ) )
+		return false;
+
+	return readArray( file, data.positions, header.numPositions ) &&
+		   readArray( file, data.texcoords, header.numTexCoords ) &&
+		   readArray( file, data.normals, header.numNormals ) &&
+		   readArray( file, data.faceSizes, header.numFaces ) &&
+		   readArray( file, data.faceElements, header.numFaceElements );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Batch sink
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+void basic_spatialpartition<Real>::vertices( const vector_type* v, size_t count )
+{
+	// Nothing is partitioned once finish() is bound to fail
+	if( _failed )
+		return;
+
+	for( size_t i = 0; i < count; ++i )
+		_vertexTiles.push_back( tileOf( v[i] ) );
+
+	_positions.write( (const char*)v, (std::streamsize)( count * sizeof( vector_type ) ) );
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::normals( const vector_type* n, size_t count )
+{
+	_normals.write( (const char*)n, (std::streamsize)( count * sizeof( vector_type ) ) );
+	_numNormals += (unsigned int)count;
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::texcoords( const vector_type* t, size_t count )
+{
+	_texcoords.write( (const char*)t, (std::streamsize)( count * sizeof( vector_type ) ) );
+	_numTexCoords += (unsigned int)count;
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::faces( const unsigned int* sizes, size_t numFaces, const face_index* elements, size_t /*numElements*/ )
+{
+	if( _failed )
+		return;
+
+	for( size_t f = 0; f < numFaces; ++f )
+	{
+		const face_index* face = elements;
+		const unsigned int size = sizes[f];
+		elements += size;
+
+		if( size == 0 || !isValid( face, size ) )
+		{
+			++_numSkippedFaces;
+			continue;
+		}
+
+		const unsigned int first = _vertexTiles[face[0].vertexIdx - 1];
+		route( first, face, size );
+
+		if( facePolicy != EVERY_TILE )
+			continue;
+
+		// Each other tile once
+		for( unsigned int i = 1; i < size; ++i )
+		{
+			const unsigned int t = _vertexTiles[face[i].vertexIdx - 1];
+
+			bool routed = ( t == first );
+			for( unsigned int j = 1; j < i && !routed; ++j )
+				routed = ( _vertexTiles[face[j].vertexIdx - 1] == t );
+
+			if( !routed )
+				route( t, face, size );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+unsigned int basic_spatialpartition<Real>::tileOf( const vector_type& v )
+{
+	cell c;
+	c.x = cellCoordinate( v.x, _cellSize );
+	c.y = cellCoordinate( v.y, _cellSize );
+	c.z = cellCoordinate( v.z, _cellSize );
+
+	if( _lastTile != ~0u && c.x == _lastCell.x && c.y == _lastCell.y && c.z == _lastCell.z )
+		return _lastTile;
+
+	typename std::map<cell, unsigned int>::iterator it = _cells.find( c );
+	if( it == _cells.end() )
+	{
+		char name[64];
+		sprintf( name, "tile_%d_%d_%d.bin", c.x, c.y, c.z );
+
+		tile t;
+		t.x = c.x;
+		t.y = c.y;
+		t.z = c.z;
+		t.filename = _directory.empty() ? name : _directory + "/" + name;
+		t.numPositions = 0;
+		t.numTexCoords = 0;
+		t.numNormals = 0;
+		t.numFaces = 0;
+		t.numFaceElements = 0;
+
+		facebuffer b;
+		b.numFaces = 0;
+		b.spilled = false;
+
+		it = _cells.insert( std::make_pair( c, (unsigned int)_tiles.size() ) ).first;
+		_tiles.push_back( t );
+		_faces.push_back( b );
+	}
+
+	_lastCell = c;
+	_lastTile = it->second;
+	return _lastTile;
+}
+
+template<typename Real>
+bool basic_spatialpartition<Real>::isValid( const face_index* face, unsigned int size ) const
+{
+	const int numVertices = (int)_vertexTiles.size();
+
+	for( unsigned int i = 0; i < size; ++i )
+	{
+		if( face[i].vertexIdx < 1 || face[i].vertexIdx > numVertices ||
+			face[i].texCoordIdx < 0 || face[i].texCoordIdx > (int)_numTexCoords ||
+			face[i].normalIdx < 0 || face[i].normalIdx > (int)_numNormals )
+			return false;
+	}
+
+	return true;
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::route( unsigned int t, const face_index* face, unsigned int size )
+{
+	facebuffer& b = _faces[t];
+
+	b.data.push_back( size );
+
+	const size_t start = b.data.size();
+	b.data.resize( start + size * ELEMENT_SIZE );
+	memcpy( &b.data[start], face, size * sizeof( face_index ) );
+
+	++b.numFaces;
+
+	if( b.data.size() * sizeof( unsigned int ) >= tileBufferSize )
+		spill( t );
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::spill( unsigned int t )
+{
+	facebuffer& b = _faces[t];
+
+	std::ofstream file( facesFile( t ).c_str(), std::ios::binary | ( b.spilled ? std::ios::app : std::ios::trunc ) );
+
+	if( !b.data.empty() )
+		file.write( (const char*)&b.data[0], (std::streamsize)( b.data.size() * sizeof( unsigned int ) ) );
+
+	file.close();
+	if( file.fail() )
+		_failed = true;
+
+	b.data.clear();
+	b.spilled = true;
+}
+
+template<typename Real>
+bool basic_spatialpartition<Real>::writeTile( unsigned int t, const std::vector<unsigned int>& owned,
+											 const char* positions, const char* texcoords, const char* normals )
+{
+	facebuffer& b = _faces[t];
+
+	// Faces of tile, spilled ones were all written to its file by finish()
+	std::vector<unsigned int> faces;
+	if( b.spilled )
+	{
+		std::ifstream file( facesFile( t ).c_str(), std::ios::binary );
+		file.seekg( 0, std::ios::end );
+		const size_t size = (size_t)file.tellg();
+		file.seekg( 0, std::ios::beg );
+
+		faces.resize( size / sizeof( unsigned int ) );
+		if( !faces.empty() && !file.read( (char*)&faces[0], (std::streamsize)( faces.size() * sizeof( unsigned int ) ) ) )
+			return false;
+	}
+	else
+	{
+		faces.swap( b.data );
+	}
+
+	// Global 0 based indices of attributes used by tile
+	std::vector<unsigned int> vertexSet( owned );
+	std::vector<unsigned int> texcoordSet;
+	std::vector<unsigned int> normalSet;
+
+	std::vector<unsigned int> faceSizes;
+	faceSizes.reserve( b.numFaces );
+
+	for( size_t i = 0; i < faces.size(); i += 1 + faces[i] * ELEMENT_SIZE )
+	{
+		faceSizes.push_back( faces[i] );
+
+		const face_index* face = (const face_index*)&faces[i + 1];
+		for( unsigned int j = 0; j < faces[i]; ++j )
+		{
+			vertexSet.push_back( face[j].vertexIdx - 1 );
+
+			if( face[j].texCoordIdx > 0 )
+				texcoordSet.push_back( face[j].texCoordIdx - 1 );
+
+			if( face[j].normalIdx > 0 )
+				normalSet.push_back( face[j].normalIdx - 1 );
+		}
+	}
+
+	makeSet( vertexSet );
+	makeSet( texcoordSet );
+	makeSet( normalSet );
+
+	// Elements with local indices
+	std::vector<face_index> faceElements;
+	faceElements.reserve( ( faces.size() - faceSizes.size() ) / ELEMENT_SIZE );
+
+	for( size_t i = 0; i < faces.size(); i += 1 + faces[i] * ELEMENT_SIZE )
+	{
+		const face_index* face = (const face_index*)&faces[i + 1];
+		for( unsigned int j = 0; j < faces[i]; ++j )
+		{
+			face_index idx;
+			idx.vertexIdx = localIndex( vertexSet, face[j].vertexIdx );
+			idx.texCoordIdx = localIndex( texcoordSet, face[j].texCoordIdx );
+			idx.normalIdx = localIndex( normalSet, face[j].normalIdx );
+			faceElements.push_back( idx );
+		}
+	}
+
+	std::vector<unsigned int>().swap( faces );
+
+	tiledata data;
+	gather( data.positions, vertexSet, positions );
+	gather( data.texcoords, texcoordSet, texcoords );
+	gather( data.normals, normalSet, normals );
+
+	tile& info = _tiles[t];
+	info.numPositions = (unsigned int)data.positions.size();
+	info.numTexCoords = (unsigned int)data.texcoords.size();
+	info.numNormals = (unsigned int)data.normals.size();
+	info.numFaces = (unsigned int)faceSizes.size();
+	info.numFaceElements = (unsigned int)faceElements.size();
+
+	tileheader header;
+	memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+	header.version = VERSION;
+	header.realSize = sizeof( Real );
+	header.x = info.x;
+	header.y = info.y;
+	header.z = info.z;
+	header.numPositions = info.numPositions;
+	header.numTexCoords = info.numTexCoords;
+	header.numNormals = info.numNormals;
+	header.numFaces = info.numFaces;
+	header.numFaceElements = info.numFaceElements;
+
+	std::ofstream file( info.filename.c_str(), std::ios::binary | std::ios::trunc );
+	file.write( (const char*)&header, sizeof( header ) );
+	writeArray( file, data.positions );
+	writeArray( file, data.texcoords );
+	writeArray( file, data.normals );
+	writeArray( file, faceSizes );
+	writeArray( file, faceElements );
+	file.close();
+
+	return !file.fail();
+}
+
+template<typename Real>
+std::string basic_spatialpartition<Real>::tempFile( const char* name ) const
+{
+	const std::string filename = _tempPrefix + name + ".tmp";
+	return _directory.empty() ? filename : _directory + "/" + filename;
+}
+
+template<typename Real>
+std::string basic_spatialpartition<Real>::facesFile( unsigned int t ) const
+{
+	char name[32];
+	sprintf( name, "faces_%u", t );
+	return tempFile( name );
+}
+
+template<typename Real>
+void basic_spatialpartition<Real>::removeTempFiles()
+{
+	remove( tempFile( "positions" ).c_str() );
+	remove( tempFile( "texcoords" ).c_str() );
+	remove( tempFile( "normals" ).c_str() );
+
+	for( unsigned int t = 0; t < _faces.size(); ++t )
+	{
+		if( _faces[t].spilled )
+			remove( facesFile( t ).c_str() );
+
+		_faces[t].spilled = false;
+	}
+}
+
+namespace obj
+{
+	template class basic_spatialpartition<double>;
+	template class basic_spatialpartition<float>;
+}
@@ -0,0 +1,118 @@
+#include <obj/symboltable.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace obj;
+
+// Initial number of slots
+static const size_t INITIAL_CAPACITY = 64;
+
+// Size of text blocks, longer names get a block of their own
+static const size_t TEXT_BLOCK_SIZE = 64 * 1024;
+
+symboltable::symboltable()
+{
+	clear();
+}
+
+symboltable::~symboltable()
+{
+	for( size_t i = 0; i < _blocks.size(); ++i )
+		delete[] _blocks[i];
+}
+
+void symboltable::clear()
+{
+	for( size_t i = 0; i < _blocks.size(); ++i )
+		delete[] _blocks[i];
+
+	_blocks.clear();
+	_blockUsed = 0;
+	_blockSize = 0;
+
+	_symbols.clear();
+	_slots.assign( INITIAL_CAPACITY, (unsigned int)EMPTY );
+	_mask = INITIAL_CAPACITY - 1;
+}
+
+unsigned int symboltable::intern( const char* begin, const char* end )
+{
+	const unsigned int h = hash( begin, end );
+	const unsigned int length = (unsigned int)( end - begin );
+
+	size_t i = h & _mask;
+
+	while( _slots[i] != EMPTY )
+	{
+		const symbol& s = _symbols[_slots[i]];
+
+		if( s.hash == h && s.length == length && memcmp( s.text, begin, length ) == 0 )
+			return _slots[i];
+
+		i = ( i + 1 ) & _mask;
+	}
+
+	symbol s;
+	s.text = store( begin, end );
+	s.length = length;
+	s.hash = h;
+
+	const unsigned int id = (unsigned int)_symbols.size();
+	_symbols.push_back( s );
+	_slots[i] = id;
+
+	// Keep load factor below one half
+	if( 2 * _symbols.size() > _slots.size() )
+		grow();
+
+	return id;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+unsigned int symboltable::hash( const char* begin, const char* end )
+{
+	// FNV-1a
+	unsigned int h = 2166136261u;
+	for( const char* p = begin; p != end; ++p )
+	{
+		h ^= (unsigned char)*p;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+const char* symboltable::store( const char* begin, const char* end )
+{
+	const size_t size = ( end - begin ) + 1;
+
+	if( _blockUsed + size > _blockSize )
+	{
+		_blockSize = std::max( size, TEXT_BLOCK_SIZE );
+		_blocks.push_back( new char[_blockSize] );
+		_blockUsed = 0;
+	}
+
+	char* text = _blocks.back() + _blockUsed;
+	memcpy( text, begin, size - 1 );
+	text[size - 1] = '\0';
+
+	_blockUsed += size;
+	return text;
+}
+
+void symboltable::grow()
+{
+	_slots.assign( _slots.size() * 2, (unsigned int)EMPTY );
+	_mask = _slots.size() - 1;
+
+	for( unsigned int id = 0; id < _symbols.size(); ++id )
+	{
+		size_t i = _symbols[id].hash & _mask;
+		while( _slots[i] != EMPTY )
+			i = ( i + 1 ) & _mask;
+
+		_slots[i] = id;
+	}
+}
@@ -0,0 +1,195 @@
+#include "thread.h"
+
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+using namespace obj;
+
+namespace
+{
+	struct threadstart
+	{
+		thread::function f;
+		void* arg;
+	};
+
+#ifdef _WIN32
+	DWORD WINAPI threadEntry( LPVOID p )
+#else
+	void* threadEntry( void* p )
+#endif
+	{
+		threadstart start = *(threadstart*)p;
+		delete (threadstart*)p;
+
+		start.f( start.arg );
+		return 0;
+	}
+}
+
+#ifdef _WIN32
+
+mutex::mutex()
+{
+	InitializeCriticalSection( &_handle );
+}
+
+mutex::~mutex()
+{
+	DeleteCriticalSection( &_handle );
+}
+
+void mutex::lock()
+{
+	EnterCriticalSection( &_handle );
+}
+
+void mutex::unlock()
+{
+	LeaveCriticalSection( &_handle );
+}
+
+condition::condition()
+{
+	InitializeConditionVariable( &_handle );
+}
+
+condition::~condition()
+{
+	// empty
+}
+
+void condition::wait( mutex& m )
+{
+	SleepConditionVariableCS( &_handle, &m._handle, INFINITE );
+}
+
+void condition::notifyAll()
+{
+	WakeAllConditionVariable( &_handle );
+}
+
+bool thread::start( function f, void* arg )
+{
+	join();
+
+	threadstart* s = new threadstart;
+	s->f = f;
+	s->arg = arg;
+
+	_handle = CreateThread( 0, 0, threadEntry, s, 0, 0 );
+	if( !_handle )
+	{
+		delete s;
+		return false;
+	}
+
+	_running = true;
+	return true;
+}
+
+void thread::join()
+{
+	if( !_running )
+		return;
+
+	WaitForSingleObject( _handle, INFINITE );
+	CloseHandle( _handle );
+	_running = false;
+}
+
+unsigned int thread::hardwareConcurrency()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors > 0 ? (unsigned int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+mutex::mutex()
+{
+	pthread_mutex_init( &_handle, 0 );
+}
+
+mutex::~mutex()
+{
+	pthread_mutex_destroy( &_handle );
+}
+
+void mutex::lock()
+{
+	pthread_mutex_lock( &_handle );
+}
+
+void mutex::unlock()
+{
+	pthread_mutex_unlock( &_handle );
+}
+
+condition::condition()
+{
+	pthread_cond_init( &_handle, 0 );
+}
+
+condition::~condition()
+{
+	pthread_cond_destroy( &_handle );
+}
+
+void condition::wait( mutex& m )
+{
+	pthread_cond_wait( &_handle, &m._handle );
+}
+
+void condition::notifyAll()
+{
+	pthread_cond_broadcast( &_handle );
+}
+
+bool thread::start( function f, void* arg )
+{
+	join();
+
+	threadstart* s = new threadstart;
+	s->f = f;
+	s->arg = arg;
+
+	if( pthread_create( &_handle, 0, threadEntry, s ) != 0 )
+	{
+		delete s;
+		return false;
+	}
+
+	_running = true;
+	return true;
+}
+
+void thread::join()
+{
+	if( !_running )
+		return;
+
+	pthread_join( _handle, 0 );
+	_running = false;
+}
+
+unsigned int thread::hardwareConcurrency()
+{
+	long n = sysconf( _SC_NPROCESSORS_ONLN );
+	return n > 0 ? (unsigned int)n : 1;
+}
+
+#endif
+
+thread::thread()
+	: _running( false )
+{
+	// empty
+}
+
+thread::~thread()
+{
+	join();
+}
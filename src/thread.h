@@ -0,0 +1,115 @@
+#ifndef _OBJ_THREAD_H_
+#define _OBJ_THREAD_H_
+
+#ifdef _WIN32
+	#ifndef _WIN32_WINNT
+		#define _WIN32_WINNT 0x0600 // condition variables
+	#endif
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+
+namespace obj
+{
+	/*
+	 *	Minimal threading primitives on top of Win32 and pthreads.
+	 */
+	class mutex
+	{
+	public:
+		mutex();
+		~mutex();
+
+		void lock();
+		void unlock();
+
+	private:
+		friend class condition;
+
+		// Non copyable
+		mutex( const mutex& );
+		mutex& operator=( const mutex& );
+
+#ifdef _WIN32
+		CRITICAL_SECTION _handle;
+#else
+		pthread_mutex_t _handle;
+#endif
+	};
+
+	class scoped_lock
+	{
+	public:
+		scoped_lock( mutex& m )
+			: _mutex( m )
+		{
+			_mutex.lock();
+		}
+
+		~scoped_lock()
+		{
+			_mutex.unlock();
+		}
+
+	private:
+		// Non copyable
+		scoped_lock( const scoped_lock& );
+		scoped_lock& operator=( const scoped_lock& );
+
+		mutex& _mutex;
+	};
+
+	class condition
+	{
+	public:
+		condition();
+		~condition();
+
+		// Mutex must be locked by caller
+		void wait( mutex& m );
+		void notifyAll();
+
+	private:
+		// Non copyable
+		condition( const condition& );
+		condition& operator=( const condition& );
+
+#ifdef _WIN32
+		CONDITION_VARIABLE _handle;
+#else
+		pthread_cond_t _handle;
+#endif
+	};
+
+	class thread
+	{
+	public:
+		typedef void (*function)( void* arg );
+
+		thread();
+		~thread();
+
+		bool start( function f, void* arg );
+		void join();
+
+		// Number of processors available, at least one
+		static unsigned int hardwareConcurrency();
+
+	private:
+		// Non copyable
+		thread( const thread& );
+		thread& operator=( const thread& );
+
+		bool _running;
+#ifdef _WIN32
+		HANDLE _handle;
+#else
+		pthread_t _handle;
+#endif
+	};
+}
+
+#endif // _OBJ_THREAD_H_
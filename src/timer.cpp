@@ -0,0 +1,47 @@
+#include "timer.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+#ifdef _WIN32
+
+double obj::now()
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	QueryPerformanceFrequency( &frequency );
+	QueryPerformanceCounter( &counter );
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+#else
+
+double obj::now()
+{
+	timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
+
+double obj::timerOverhead()
+{
+	double overhead = 1.0;
+
+	for( int i = 0; i < 16; ++i )
+	{
+		const double start = now();
+		const double elapsed = now() - start;
+
+		if( elapsed < overhead )
+			overhead = elapsed;
+	}
+
+	return overhead;
+}
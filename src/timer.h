@@ -0,0 +1,13 @@
+#ifndef _OBJ_TIMER_H_
+#define _OBJ_TIMER_H_
+
+namespace obj
+{
+	// Monotonic wall clock time in seconds
+	double now();
+
+	// Smallest time between two consecutive calls to now()
+	double timerOverhead();
+}
+
+#endif // _OBJ_TIMER_H_
@@ -0,0 +1,199 @@
+#include <obj/triangulator.h>
+
+using namespace obj;
+
+template<typename Real>
+bool basic_triangulator<Real>::triangulate( const vector_type* corners, unsigned int numCorners )
+{
+	if( numCorners < 3 )
+	{
+		_triangles.clear();
+		return true;
+	}
+
+	// Collinear or coincident corners have no plane, any split is as good
+	if( numCorners == 3 || !project( corners, numCorners ) || isConvex( numCorners ) )
+	{
+		fan( numCorners );
+		return true;
+	}
+
+	clipEars( numCorners );
+	return false;
+}
+
+template<typename Real>
+void basic_triangulator<Real>::fan( unsigned int numCorners )
+{
+	_triangles.clear();
+
+	for( unsigned int i = 2; i < numCorners; ++i )
+	{
+		_triangles.push_back( 0 );
+		_triangles.push_back( i - 1 );
+		_triangles.push_back( i );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+template<typename Real>
+bool basic_triangulator<Real>::project( const vector_type* corners, unsigned int numCorners )
+{
+	// Newell normal
+	Real normal[3] = { 0, 0, 0 };
+
+	for( unsigned int i = 0, j = numCorners - 1; i < numCorners; j = i++ )
+	{
+		const vector_type& a = corners[j];
+		const vector_type& b = corners[i];
+		normal[0] += ( a.y - b.y ) * ( a.z + b.z );
+		normal[1] += ( a.z - b.z ) * ( a.x + b.x );
+		normal[2] += ( a.x - b.x ) * ( a.y + b.y );
+	}
+
+	// Drop largest component, the other two follow it in x, y, z order
+	unsigned int axis = 0;
+	for( unsigned int k = 1; k < 3; ++k )
+		if( ( normal[k] < 0 ? -normal[k] : normal[k] ) > ( normal[axis] < 0 ? -normal[axis] : normal[axis] ) )
+			axis = k;
+
+	if( normal[axis] == 0 )
+		return false;
+
+	const unsigned int u = ( axis + 1 ) % 3;
+	const unsigned int v = ( axis + 2 ) % 3;
+
+	// Mirror clockwise polygons
+	const Real sign = ( normal[axis] > 0 ) ? Real( 1 ) : Real( -1 );
+
+	_points.resize( 2 * numCorners );
+	for( unsigned int i = 0; i < numCorners; ++i )
+	{
+		const Real* p = &corners[i].x;
+		_points[2 * i] = sign * p[u];
+		_points[2 * i + 1] = p[v];
+	}
+
+	return true;
+}
+
+template<typename Real>
+bool basic_triangulator<Real>::isConvex( unsigned int numCorners ) const
+{
+	// No reflex corner
+	for( unsigned int i = 0; i < numCorners; ++i )
+	{
+		const unsigned int prev = ( i + numCorners - 1 ) % numCorners;
+		const unsigned int next = ( i + 1 ) % numCorners;
+
+		if( area( prev, i, next ) < 0 )
+			return false;
+	}
+
+	// And winding once: edge directions change sign at most twice on each axis
+	for( unsigned int k = 0; k < 2; ++k )
+	{
+		unsigned int numChanges = 0;
+		int first = 0;
+		int last = 0;
+
+		for( unsigned int i = 0; i < numCorners; ++i )
+		{
+			const Real d = _points[2 * ( ( i + 1 ) % numCorners ) + k] - _points[2 * i + k];
+			const int sign = ( d > 0 ) - ( d < 0 );
+
+			if( sign == 0 )
+				continue;
+
+			if( first == 0 )
+				first = sign;
+			else if( sign != last )
+				++numChanges;
+
+			last = sign;
+		}
+
+		// Back to the first edge
+		if( last != first )
+			++numChanges;
+
+		if( numChanges > 2 )
+			return false;
+	}
+
+	return true;
+}
+
+template<typename Real>
+bool basic_triangulator<Real>::isEar( unsigned int prev, unsigned int i, unsigned int next ) const
+{
+	const unsigned int a = _remaining[prev];
+	const unsigned int b = _remaining[i];
+	const unsigned int c = _remaining[next];
+
+	if( area( a, b, c ) <= 0 )
+		return false;
+
+	// No other corner inside or on the triangle
+	for( size_t j = 0; j < _remaining.size(); ++j )
+	{
+		const unsigned int p = _remaining[j];
+		if( p == a || p == b || p == c )
+			continue;
+
+		if( area( a, b, p ) >= 0 && area( b, c, p ) >= 0 && area( c, a, p ) >= 0 )
+			return false;
+	}
+
+	return true;
+}
+
+template<typename Real>
+void basic_triangulator<Real>::clipEars( unsigned int numCorners )
+{
+	_triangles.clear();
+	_remaining.clear();
+
+	for( unsigned int i = 0; i < numCorners; ++i )
+		_remaining.push_back( i );
+
+	unsigned int i = 0;
+	unsigned int numTried = 0;
+
+	while( _remaining.size() > 3 )
+	{
+		const unsigned int count = (unsigned int)_remaining.size();
+		const unsigned int prev = ( i + count - 1 ) % count;
+		const unsigned int next = ( i + 1 ) % count;
+
+		// Self intersecting polygons may have no ear left, clip anyway to finish
+		if( numTried < count && !isEar( prev, i, next ) )
+		{
+			i = next;
+			++numTried;
+			continue;
+		}
+
+		_triangles.push_back( _remaining[prev] );
+		_triangles.push_back( _remaining[i] );
+		_triangles.push_back( _remaining[next] );
+
+		_remaining.erase( _remaining.begin() + i );
+		if( i == _remaining.size() )
+			i = 0;
+
+		numTried = 0;
+	}
+
+	_triangles.push_back( _remaining[0] );
+	_triangles.push_back( _remaining[1] );
+	_triangles.push_back( _remaining[2] );
+}
+
+namespace obj
+{
+	template class basic_triangulator<double>;
+	template class basic_triangulator<float>;
+}
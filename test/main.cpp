@@ -0,0 +1,343 @@
+#include "../src/scanner.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ *	Compares scanner::parseDouble and scanner::parseFloat with strtod and
+ *	strtof bit for bit, overflow included. The C library must round
+ *	correctly, as glibc and Visual C++ 2015 and later do. Exits with 1
+ *	on any mismatch.
+ *
+ *	test [-count n]
+ */
+
+#if defined( _MSC_VER ) && _MSC_VER < 1800
+	#define OBJ_NO_STRTOF
+#endif
+
+/************************************************************************/
+/* Checks                                                               */
+/************************************************************************/
+
+static unsigned long long numChecked = 0;
+static unsigned long long numFailed = 0;
+
+static void fail( const char* type, const std::string& text, const std::string& got, const std::string& expected )
+{
+	// Only the first mismatches, all of them are counted
+	if( numFailed++ < 20 )
+		std::cout << type << " '" << text << "': got " << got << ", expected " << expected << std::endl;
+}
+
+static std::string describe( bool ok, double value )
+{
+	if( !ok )
+		return "error";
+
+	char buffer[64];
+	sprintf( buffer, "%.17g", value );
+	return buffer;
+}
+
+static void checkDouble( const std::string& text )
+{
+	const char* p = text.c_str();
+	const char* end = p + text.size();
+
+	double value = 0.0;
+	const bool ok = obj::scanner::parseDouble( p, end, value ) && p == end;
+
+	// Overflow is a parse error
+	const double expected = strtod( text.c_str(), 0 );
+	const bool expectedOk = ( expected != HUGE_VAL && expected != -HUGE_VAL );
+
+	if( ok != expectedOk || ( ok && memcmp( &value, &expected, sizeof( value ) ) != 0 ) )
+		fail( "double", text, describe( ok, value ), describe( expectedOk, expected ) );
+}
+
+static void checkFloat( const std::string& text )
+{
+#ifndef OBJ_NO_STRTOF
+	const char* p = text.c_str();
+	const char* end = p + text.size();
+
+	float value = 0.0f;
+	const bool ok = obj::scanner::parseFloat( p, end, value ) && p == end;
+
+	const float expected = strtof( text.c_str(), 0 );
+	const bool expectedOk = ( expected != HUGE_VALF && expected != -HUGE_VALF );
+
+	if( ok != expectedOk || ( ok && memcmp( &value, &expected, sizeof( value ) ) != 0 ) )
+		fail( "float", text, describe( ok, value ), describe( expectedOk, expected ) );
+#endif
+}
+
+static void check( const std::string& text )
+{
+	++numChecked;
+	checkDouble( text );
+	checkFloat( text );
+}
+
+/************************************************************************/
+/* Inputs                                                               */
+/************************************************************************/
+
+// Deterministic random numbers, failures can be reproduced
+class xorshift
+{
+public:
+	xorshift()
+		: _state( 88172645463325252ull )
+	{
+		// empty
+	}
+
+	unsigned long long next()
+	{
+		_state ^= _state << 13;
+		_state ^= _state >> 7;
+		_state ^= _state << 17;
+		return _state;
+	}
+
+	unsigned int below( unsigned int n )
+	{
+		return (unsigned int)( next() % n );
+	}
+
+private:
+	unsigned long long _state;
+};
+
+// Exact decimal text of n * 2^power
+static std::string exactDecimal( unsigned long long n, int power )
+{
+	// Digits in base 10^9, lowest first
+	std::vector<unsigned int> digits;
+	digits.push_back( (unsigned int)( n % 1000000000u ) );
+	digits.push_back( (unsigned int)( n / 1000000000u % 1000000000u ) );
+	digits.push_back( (unsigned int)( n / 1000000000u / 1000000000u ) );
+
+	// n * 2^power = n * 5^-power / 10^-power for negative powers
+	const unsigned int factor = ( power >= 0 ) ? 2 : 5;
+	for( int i = 0; i < ( power >= 0 ? power : -power ); ++i )
+	{
+		unsigned long long carry = 0;
+		for( size_t k = 0; k < digits.size(); ++k )
+		{
+			carry += (unsigned long long)digits[k] * factor;
+			digits[k] = (unsigned int)( carry % 1000000000u );
+			carry /= 1000000000u;
+		}
+
+		if( carry )
+			digits.push_back( (unsigned int)carry );
+	}
+
+	while( digits.size() > 1 && digits.back() == 0 )
+		digits.pop_back();
+
+	char buffer[16];
+	sprintf( buffer, "%u", digits.back() );
+	std::string text = buffer;
+
+	for( size_t k = digits.size() - 1; k > 0; --k )
+	{
+		sprintf( buffer, "%09u", digits[k - 1] );
+		text += buffer;
+	}
+
+	if( power >= 0 )
+		return text;
+
+	// Place the decimal point
+	const size_t numFraction = (size_t)-power;
+	if( text.size() <= numFraction )
+		text.insert( 0, numFraction - text.size() + 1, '0' );
+
+	text.insert( text.size() - numFraction, "." );
+	return text;
+}
+
+// Exactly between mantissa * 2^exponent and the next larger number, then slightly above and below
+static void checkHalfway( unsigned long long mantissa, int exponent )
+{
+	const std::string middle = exactDecimal( 2 * mantissa + 1, exponent - 1 );
+	check( middle );
+
+	if( middle.find( '.' ) == std::string::npos )
+	{
+		check( middle + ".000000000000000000001" );
+	}
+	else
+	{
+		// Last digit of an exact fraction is not zero
+		check( middle + "000000000000000000001" );
+		check( middle.substr( 0, middle.size() - 1 ) );
+	}
+
+	// Just below, with few enough digits to be converted in double precision first
+	const size_t point = middle.find( '.' );
+	const size_t first = middle.find_first_not_of( "0." );
+	for( size_t numDigits = 15; numDigits <= 19; ++numDigits )
+	{
+		size_t last = first;
+		for( size_t k = 0; last < middle.size() && k < numDigits; ++last )
+		{
+			if( middle[last] != '.' )
+				++k;
+		}
+
+		// Only fraction digits can be dropped
+		if( point != std::string::npos && last > point && last < middle.size() )
+			check( middle.substr( 0, last ) );
+	}
+}
+
+static void checkFixed()
+{
+	static const char* const numbers[] = {
+		"0", "-0", "1", "-1", "0.1", "+2.5", ".5", "5.", "1e0", "1E+2", "1e-2",
+		"123456789", "1234567890123456789", "12345678901234567890", "0.000000000000000000000000000000123456789",
+		"9007199254740993", "9007199254740992.5", "16777217", "33554435", "1e23", "8.589973e9",
+
+		// Largest, smallest and subnormal doubles
+		"1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308", "2e308", "-2e308", "1e400",
+		"2.2250738585072011e-308", "2.2250738585072014e-308", "4.9406564584124654e-324",
+		"2.4703282292062327e-324", "2.4703282292062328e-324", "1e-400",
+
+		// Same for floats
+		"3.4028235e38", "3.40282357e38", "3.4028236e38", "-3.4028236e38", "1e39",
+		"1.17549435e-38", "1.4e-45", "7e-46", "7.1e-46", "1e-46",
+
+		// Halfway with many digits
+		"1.00000000000000011102230246251565404236316680908203125",
+		"1.00000000000000011102230246251565404236316680908203124",
+		"1.00000000000000011102230246251565404236316680908203126",
+		"16777217.0000000000000000001",
+		"4.7019774032891500318749461488889827112746622270883500860350068251e-38"
+	};
+
+	for( size_t i = 0; i < sizeof( numbers ) / sizeof( numbers[0] ); ++i )
+		check( numbers[i] );
+}
+
+static void checkRandom( xorshift& random, unsigned int count )
+{
+	char buffer[256];
+
+	for( unsigned int i = 0; i < count; ++i )
+	{
+		switch( i % 6 )
+		{
+		// Any double, subnormals included, with 1 to 20 significant digits
+		case 0:
+		{
+			const unsigned long long bits = random.next();
+			double value;
+			memcpy( &value, &bits, sizeof( value ) );
+
+			if( value != value || value == HUGE_VAL || value == -HUGE_VAL )
+				continue;
+
+			sprintf( buffer, "%.*g", (int)random.below( 20 ) + 1, value );
+			break;
+		}
+		// Any float
+		case 1:
+		{
+			const unsigned int bits = (unsigned int)random.next();
+			float value;
+			memcpy( &value, &bits, sizeof( value ) );
+
+			if( value != value || value > FLT_MAX || value < -FLT_MAX )
+				continue;
+
+			sprintf( buffer, "%.*g", (int)random.below( 12 ) + 1, (double)value );
+			break;
+		}
+		// Subnormal doubles and floats
+		case 2:
+		{
+			const unsigned long long bits = random.next() >> ( 12 + random.below( 40 ) );
+			double value;
+			memcpy( &value, &bits, sizeof( value ) );
+
+			const double tiny = ldexp( (double)( random.next() >> 40 ), -149 - 24 );
+			sprintf( buffer, "%.*g", (int)random.below( 20 ) + 1, ( i & 1 ) ? value : tiny );
+			break;
+		}
+		// Digit strings up to 40 long with the point anywhere and any exponent
+		case 3:
+		{
+			std::string digits;
+			const unsigned int numDigits = random.below( 40 ) + 1;
+
+			for( unsigned int k = 0; k < numDigits; ++k )
+				digits += (char)( '0' + random.below( 10 ) );
+
+			if( random.below( 2 ) )
+				digits.insert( random.below( numDigits + 1 ), "." );
+
+			if( digits == "." )
+				digits = "0";
+
+			sprintf( buffer, "%se%d", digits.c_str(), (int)random.below( 760 ) - 380 );
+			break;
+		}
+		// Halfway between two doubles, normal range
+		case 4:
+		{
+			const unsigned long long mantissa = ( 1ull << 52 ) | ( random.next() >> 12 );
+			checkHalfway( mantissa, (int)random.below( 200 ) - 100 - 52 );
+			continue;
+		}
+		// Halfway between two floats, subnormals included
+		default:
+		{
+			const unsigned long long mantissa = ( random.below( 8 ) == 0 ) ? random.below( 1 << 23 ) : ( ( 1u << 23 ) | random.below( 1 << 23 ) );
+			const int exponent = ( mantissa < ( 1u << 23 ) ) ? -149 : (int)random.below( 250 ) - 126 - 23;
+			checkHalfway( mantissa, exponent );
+			continue;
+		}
+		}
+
+		check( buffer );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	unsigned int count = 1000000;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const std::string arg = argv[i];
+
+		if( arg == "-count" && i + 1 < argc )
+			count = (unsigned int)atoi( argv[++i] );
+		else
+		{
+			std::cout << "Usage: test [-count n]" << std::endl;
+			return 1;
+		}
+	}
+
+#ifdef OBJ_NO_STRTOF
+	std::cout << "strtof not available, checking doubles only" << std::endl;
+#endif
+
+	xorshift random;
+	checkFixed();
+	checkRandom( random, count );
+
+	std::cout << numChecked << " numbers, " << numFailed << " mismatches" << std::endl;
+	return ( numFailed == 0 ) ? 0 : 1;
+}